@@ -13,6 +13,9 @@
 #include "chksumfile.h"
 #include <openssl/sha.h>
 
+// Most blocks chksumfile_byinumber reads at once
+#define CHKSUMFILE_MAX_RUN 16
+
 int chksumfile_byinumber(struct unixfilesystem *fs, int inumber, void *chksum) {
   SHA_CTX shactx;
   if (!SHA1_Init(&shactx)) {
@@ -31,17 +34,36 @@ int chksumfile_byinumber(struct unixfilesystem *fs, int inumber, void *chksum) {
     return -1;
   }
 
+  // Hash the file a run of physically consecutive blocks at a time, so
+  // that each run takes one read
   int size = inode_getsize(&in);
-  for (int offset = 0; offset < size; offset += DISKIMG_SECTOR_SIZE) {
-    char buf[DISKIMG_SECTOR_SIZE];
-    int bno = offset/DISKIMG_SECTOR_SIZE;
+  int numBlocks = (size + DISKIMG_SECTOR_SIZE - 1) / DISKIMG_SECTOR_SIZE;
+  int first = numBlocks > 0 ? inode_indexlookup(fs, &in, 0) : -1;
+  for (int bno = 0; bno < numBlocks; ) {
+    char buf[CHKSUMFILE_MAX_RUN * DISKIMG_SECTOR_SIZE];
+    if (first < 0)
+      return -1;
+
+    // Grow the run while the next block follows on disk.  The block that
+    // ends it is already looked up, and starts the next run
+    int run = 1;
+    int next = -1;
+    while (bno + run < numBlocks) {
+      next = inode_indexlookup(fs, &in, bno + run);
+      if (run == CHKSUMFILE_MAX_RUN || next != first + run) break;
+      run++;
+    }
 
-    int bytesMoved = file_getblock(fs, inumber, bno, buf);
-    if (bytesMoved < 0)
+    const void *blocks = unixfilesystem_getsectors(fs, first, run, buf);
+    if (blocks == NULL)
       return -1;
 
-    if (!SHA1_Update(&shactx, buf, bytesMoved))
+    int bytesMoved = size - bno * DISKIMG_SECTOR_SIZE;
+    if (bytesMoved > run * DISKIMG_SECTOR_SIZE) bytesMoved = run * DISKIMG_SECTOR_SIZE;
+    if (!SHA1_Update(&shactx, blocks, bytesMoved))
       return -1;
+    bno += run;
+    first = next;
   }
 
   if (!SHA1_Final(chksum, &shactx))
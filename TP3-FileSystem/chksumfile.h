@@ -9,7 +9,8 @@
 /**
  * Computes the checksum of a inumber.  Assumes chksum arguments points to a
  * CHKSUMFILE_SIZE byte array.  Returns the length of the checksum, or -1 if
- * it encounters an error.
+ * it encounters an error, such as a block that doesn't lie entirely within
+ * the disk image (see file_getblock).
  */
 int chksumfile_byinumber(struct unixfilesystem *fs, int inumber, void *chksum);
 
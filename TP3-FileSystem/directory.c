@@ -23,13 +23,14 @@ int directory_findname(struct unixfilesystem *fs, const char *name,
         
         for (int bno = 0; bno < numBlocks; bno++) {
             char buf[DISKIMG_SECTOR_SIZE];
-            int bytesRead = file_getblock(fs, dirinumber, bno, buf);
+            const void *block;
+            int bytesRead = file_getblockptr(fs, dirinumber, bno, buf, &block);
             
             if (bytesRead < 0) {
                 return -1;
             }
             
-            struct direntv6 *entries = (struct direntv6 *)buf;
+            const struct direntv6 *entries = block;
             int numEntries = bytesRead / sizeof(struct direntv6);
             
             for (int i = 0; i < numEntries; i++) {
@@ -1,31 +1,127 @@
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "diskimg.h"
 
-int diskimg_open(char *pathname, int readOnly) {
-  return open(pathname, readOnly ? O_RDONLY : O_RDWR);
+/**
+ * Images opened with DISKIMG_MMAP, indexed by file descriptor.  A NULL base
+ * means the descriptor is read with system calls.  Opening and closing an
+ * image may grow or change the table while other threads read other
+ * images, so it is guarded by mappingsLock.
+ */
+struct diskimg_mapping {
+  uint8_t *base;        // start of the mapped image
+  size_t size;          // bytes mapped
+};
+
+static struct diskimg_mapping *mappings = NULL;
+static int numMappings = 0;
+static pthread_rwlock_t mappingsLock = PTHREAD_RWLOCK_INITIALIZER;
+
+/**
+ * Copies fd's mapping into *m.  Returns 0 if fd isn't mapped.
+ */
+static int diskimg_mapping(int fd, struct diskimg_mapping *m) {
+  pthread_rwlock_rdlock(&mappingsLock);
+  int mapped = fd >= 0 && fd < numMappings && mappings[fd].base != NULL;
+  if (mapped) *m = mappings[fd];
+  pthread_rwlock_unlock(&mappingsLock);
+  return mapped;
+}
+
+static void diskimg_map(int fd) {
+  struct stat st;
+  if (fstat(fd, &st) < 0 || st.st_size == 0) return;
+  void *base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  if (base == MAP_FAILED) return;
+
+  pthread_rwlock_wrlock(&mappingsLock);
+  if (fd >= numMappings) {
+    struct diskimg_mapping *grown = realloc(mappings, (fd + 1) * sizeof(*grown));
+    if (grown == NULL) {
+      pthread_rwlock_unlock(&mappingsLock);
+      munmap(base, st.st_size);
+      return;
+    }
+    memset(grown + numMappings, 0, (fd + 1 - numMappings) * sizeof(*grown));
+    mappings = grown;
+    numMappings = fd + 1;
+  }
+  mappings[fd].base = base;
+  mappings[fd].size = st.st_size;
+  pthread_rwlock_unlock(&mappingsLock);
+}
+
+int diskimg_open(char *pathname, int flags) {
+  int fd = open(pathname, (flags & DISKIMG_READONLY) ? O_RDONLY : O_RDWR);
+  if (fd >= 0 && (flags & DISKIMG_MMAP)) diskimg_map(fd);
+  return fd;
 }
 
 int diskimg_getsize(int fd) {
-  return lseek(fd, 0, SEEK_END);
+  struct stat st;
+  if (fstat(fd, &st) < 0) return -1;
+  return st.st_size;
 }
 
 int diskimg_readsector(int fd, int sectorNum,  void *buf) {
-  if (lseek(fd, sectorNum * DISKIMG_SECTOR_SIZE, SEEK_SET) == (off_t) -1) return -1;  
-  return read(fd, buf, DISKIMG_SECTOR_SIZE);
+  return diskimg_readsectors(fd, sectorNum, 1, buf);
 }
 
-int diskimg_writesector(int fd, int sectorNum,  void *buf) {
-  if (lseek(fd, sectorNum * DISKIMG_SECTOR_SIZE, SEEK_SET) == (off_t) -1) {
-    return -1;
+int diskimg_readsectors(int fd, int first, int count, void *buf) {
+  if (first < 0 || count < 0) return -1;
+  off_t offset = (off_t) first * DISKIMG_SECTOR_SIZE;
+  size_t length = (size_t) count * DISKIMG_SECTOR_SIZE;
+
+  struct diskimg_mapping m;
+  if (diskimg_mapping(fd, &m)) {
+    // Same result as reading: whatever part of the range the image holds
+    if ((size_t) offset >= m.size) return 0;
+    size_t n = m.size - offset < length ? m.size - offset : length;
+    memcpy(buf, m.base + offset, n);
+    return n;
+  }
+
+  // pread may return less than asked for without being at the end of the
+  // image, so keep going until it says there is nothing more
+  size_t total = 0;
+  while (total < length) {
+    ssize_t n = pread(fd, (char *) buf + total, length - total, offset + total);
+    if (n < 0) return -1;
+    if (n == 0) break;
+    total += n;
   }
+  return total;
+}
 
-  return write(fd, buf, DISKIMG_SECTOR_SIZE);
+const void *diskimg_getsector_ptr(int fd, int sectorNum) {
+  struct diskimg_mapping m;
+  if (!diskimg_mapping(fd, &m) || sectorNum < 0) return NULL;
+  size_t offset = (size_t) sectorNum * DISKIMG_SECTOR_SIZE;
+  if (offset + DISKIMG_SECTOR_SIZE > m.size) return NULL;
+  return m.base + offset;
+}
+
+int diskimg_writesector(int fd, int sectorNum,  void *buf) {
+  if (sectorNum < 0) return -1;
+  return pwrite(fd, buf, DISKIMG_SECTOR_SIZE, (off_t) sectorNum * DISKIMG_SECTOR_SIZE);
 }
 
 int diskimg_close(int fd) {
+  struct diskimg_mapping m = { NULL, 0 };
+  pthread_rwlock_wrlock(&mappingsLock);
+  if (fd >= 0 && fd < numMappings) {
+    m = mappings[fd];
+    mappings[fd].base = NULL;
+    mappings[fd].size = 0;
+  }
+  pthread_rwlock_unlock(&mappingsLock);
+  if (m.base != NULL) munmap(m.base, m.size);
   return close(fd);
 }
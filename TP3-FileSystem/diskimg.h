@@ -6,11 +6,19 @@
 // Size of a disk sector (e.g. block) in bytes.
 #define DISKIMG_SECTOR_SIZE 512
 
+// Flags for diskimg_open.  DISKIMG_READONLY is 1 so that the historical
+// readOnly argument keeps working unchanged.
+#define DISKIMG_READONLY 1   // open the image for reading only
+#define DISKIMG_MMAP     2   // map the image into memory, see diskimg_getsector_ptr
+
 /**
  * Opens a disk image for I/O. Returns an open file descriptor, or -1 if
- * unsuccessful.  
+ * unsuccessful.  flags is a combination of the DISKIMG_ flags above; with
+ * DISKIMG_MMAP the whole image is mapped, so sectors can be read without
+ * system calls.  If the image can't be mapped it is still opened, and
+ * simply read with system calls.
  */
-int diskimg_open(char *pathname, int readOnly);
+int diskimg_open(char *pathname, int flags);
 
 /**
  * Returns the size of the disk imgage in bytes, or -1 if unsuccessful.
@@ -19,10 +27,29 @@ int diskimg_getsize(int fd);
 
 /**
  * Reads the specified sector (e.g. block) from the disk.  Returns the number of bytes read,
- * or -1 on error.
+ * or -1 on error.  The count is short for a sector at the end of an image
+ * whose size isn't a multiple of DISKIMG_SECTOR_SIZE, and 0 past it.  Reads and writes use positional I/O and never move the
+ * descriptor's file offset, so several threads can share one descriptor.
  */
 int diskimg_readsector(int fd, int sectorNum, void *buf); 
 
+/**
+ * Reads count consecutive sectors, starting at first, into buf, which must
+ * hold count * DISKIMG_SECTOR_SIZE bytes.  Returns the number of bytes
+ * read, which is less than requested only at the end of the image, or -1
+ * on error.
+ */
+int diskimg_readsectors(int fd, int first, int count, void *buf);
+
+/**
+ * Returns a pointer to the specified sector inside the mapped image, so it
+ * can be read in place without a copy.  Returns NULL if the image wasn't
+ * opened with DISKIMG_MMAP (or couldn't be mapped), or if the sector doesn't
+ * lie entirely within the image; use diskimg_readsector then.  The pointer
+ * stays valid until diskimg_close.
+ */
+const void *diskimg_getsector_ptr(int fd, int sectorNum);
+
 /**
  * Writes the specified sector from the disk.  Returns the number of bytes
  * written, or -1 on error.
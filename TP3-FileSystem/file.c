@@ -1,11 +1,12 @@
 #include <stdio.h>
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 #include "file.h"
 #include "inode.h"
 #include "diskimg.h"
 
-int file_getblock(struct unixfilesystem *fs, int inumber, int blockNum, void *buf) {
+int file_getblockptr(struct unixfilesystem *fs, int inumber, int blockNum, void *buf, const void **datap) {
     struct inode in;
 
     if (inode_iget(fs, inumber, &in) < 0) return -1;
@@ -19,10 +20,19 @@ int file_getblock(struct unixfilesystem *fs, int inumber, int blockNum, void *bu
     int physicalBlock = inode_indexlookup(fs, &in, blockNum);
     
     if (physicalBlock < 0) return -1;
-    if (diskimg_readsector(fs->dfd, physicalBlock, buf) < 0) return -1;
+    *datap = unixfilesystem_getsector(fs, physicalBlock, buf);
+    if (*datap == NULL) return -1;
     
     int remainingBytes = fileSize - (blockNum * DISKIMG_SECTOR_SIZE);
     
     if (remainingBytes >= DISKIMG_SECTOR_SIZE) return DISKIMG_SECTOR_SIZE;
     else return remainingBytes;
-}
\ No newline at end of file
+}
+
+int file_getblock(struct unixfilesystem *fs, int inumber, int blockNum, void *buf) {
+    const void *data;
+    int validBytes = file_getblockptr(fs, inumber, blockNum, buf, &data);
+    if (validBytes < 0) return -1;
+    if (data != buf) memcpy(buf, data, DISKIMG_SECTOR_SIZE);
+    return validBytes;
+}
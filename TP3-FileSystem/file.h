@@ -5,8 +5,18 @@
 
 /**
  * Fetches the specified file block from the specified inode.
- * Returns the number of valid bytes in the block, -1 on error.
+ * Returns the number of valid bytes in the block, -1 on error.  A block
+ * whose sector doesn't lie entirely within the disk image is an error,
+ * even if its valid bytes do.
  */
 int file_getblock(struct unixfilesystem *fs, int inumber, int blockNo, void *buf); 
 
+/**
+ * Like file_getblock, but avoids the copy when the disk image is memory
+ * mapped: on success *datap points at the block's contents, either inside
+ * the image or in buf (which must hold DISKIMG_SECTOR_SIZE bytes).
+ * Returns the number of valid bytes in the block, -1 on error.
+ */
+int file_getblockptr(struct unixfilesystem *fs, int inumber, int blockNo, void *buf, const void **datap);
+
 #endif // _FILE_H_
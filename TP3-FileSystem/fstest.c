@@ -340,6 +340,7 @@ int main(int argc, char *argv[]) {
     
     int err = diskimg_close(fd);
     if (err < 0) fprintf(stderr, "Error closing %s\n", diskpath);
+    sectorcache_destroy(&fs->cache);
     free(fs);
     
     return 0;
@@ -14,8 +14,9 @@ int inode_iget(struct unixfilesystem *fs, int inumber, struct inode *inp) {
     int block = INODE_START_SECTOR + (inumber - 1) / (DISKIMG_SECTOR_SIZE / sizeof(struct inode));
     int offset = (inumber - 1) % (DISKIMG_SECTOR_SIZE / sizeof(struct inode));
     
-    struct inode inodes[DISKIMG_SECTOR_SIZE / sizeof(struct inode)];
-    if (diskimg_readsector(fs->dfd, block, inodes) != DISKIMG_SECTOR_SIZE) return -1;
+    struct inode buf[DISKIMG_SECTOR_SIZE / sizeof(struct inode)];
+    const struct inode *inodes = unixfilesystem_getsector(fs, block, buf);
+    if (inodes == NULL) return -1;
     
     *inp = inodes[offset];
     return 0;
@@ -28,8 +29,9 @@ int inode_indexlookup(struct unixfilesystem *fs, struct inode *inp, int blockNum
             int which_indirect = blockNum / (DISKIMG_SECTOR_SIZE / sizeof(uint16_t));
             int offset_in_indirect = blockNum % (DISKIMG_SECTOR_SIZE / sizeof(uint16_t));
             
-            uint16_t indirect_block[DISKIMG_SECTOR_SIZE / sizeof(uint16_t)];
-            if (diskimg_readsector(fs->dfd, inp->i_addr[which_indirect], indirect_block) != DISKIMG_SECTOR_SIZE) return -1;
+            uint16_t buf[DISKIMG_SECTOR_SIZE / sizeof(uint16_t)];
+            const uint16_t *indirect_block = unixfilesystem_getsector(fs, inp->i_addr[which_indirect], buf);
+            if (indirect_block == NULL) return -1;
             return indirect_block[offset_in_indirect];
 
         } else {
@@ -37,11 +39,13 @@ int inode_indexlookup(struct unixfilesystem *fs, struct inode *inp, int blockNum
             int index1 = double_block_num / (DISKIMG_SECTOR_SIZE / sizeof(uint16_t));
             int index2 = double_block_num % (DISKIMG_SECTOR_SIZE / sizeof(uint16_t));
             
-            uint16_t double_indirect[DISKIMG_SECTOR_SIZE / sizeof(uint16_t)];
-            if (diskimg_readsector(fs->dfd, inp->i_addr[7], double_indirect) != DISKIMG_SECTOR_SIZE) return -1;
+            uint16_t buf[DISKIMG_SECTOR_SIZE / sizeof(uint16_t)];
+            const uint16_t *double_indirect = unixfilesystem_getsector(fs, inp->i_addr[7], buf);
+            if (double_indirect == NULL) return -1;
             
-            uint16_t indirect_block[DISKIMG_SECTOR_SIZE / sizeof(uint16_t)];
-            if (diskimg_readsector(fs->dfd, double_indirect[index1], indirect_block) != DISKIMG_SECTOR_SIZE) return -1;
+            // buf may be reused: the entry is copied out before the next read
+            const uint16_t *indirect_block = unixfilesystem_getsector(fs, double_indirect[index1], buf);
+            if (indirect_block == NULL) return -1;
             
             return indirect_block[index2];
         }
@@ -17,7 +17,9 @@ int pathname_lookup(struct unixfilesystem *fs, const char *pathname) {
     char *path_copy = strdup(pathname);
     if (!path_copy) return -1;
     
-    char *token = strtok(path_copy + 1, "/");
+    // strtok_r, not strtok: lookups run concurrently under diskimageaccess -j
+    char *saveptr;
+    char *token = strtok_r(path_copy + 1, "/", &saveptr);
     
     while (token != NULL) {
         struct direntv6 dirEnt;
@@ -28,7 +30,7 @@ int pathname_lookup(struct unixfilesystem *fs, const char *pathname) {
         }
         
         current_inumber = dirEnt.d_inumber;
-        token = strtok(NULL, "/");
+        token = strtok_r(NULL, "/", &saveptr);
     }
     
     free(path_copy);
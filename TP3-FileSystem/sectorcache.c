@@ -0,0 +1,91 @@
+#include <string.h>
+#include "sectorcache.h"
+
+static int sectorcache_bucket(int sectorNum) {
+  return (unsigned int) sectorNum % SECTORCACHE_NUM_BUCKETS;
+}
+
+void sectorcache_init(struct sectorcache *cache, int dfd) {
+  pthread_mutex_init(&cache->lock, NULL);
+  cache->dfd = dfd;
+  cache->hand = 0;
+  cache->hits = 0;
+  cache->misses = 0;
+  for (int i = 0; i < SECTORCACHE_NUM_BUCKETS; i++) {
+    cache->buckets[i] = -1;
+  }
+  for (int i = 0; i < SECTORCACHE_NUM_SLOTS; i++) {
+    cache->slots[i].sector = -1;
+    cache->slots[i].next = -1;
+    cache->slots[i].referenced = 0;
+  }
+}
+
+void sectorcache_destroy(struct sectorcache *cache) {
+  pthread_mutex_destroy(&cache->lock);
+}
+
+/**
+ * Returns the slot holding the sector, or -1 if it isn't cached.
+ */
+static int sectorcache_find(struct sectorcache *cache, int sectorNum) {
+  for (int s = cache->buckets[sectorcache_bucket(sectorNum)]; s != -1; s = cache->slots[s].next) {
+    if (cache->slots[s].sector == sectorNum) return s;
+  }
+  return -1;
+}
+
+/**
+ * Advances the clock hand to a slot that hasn't been referenced since the
+ * hand last passed it, unlinks whatever sector it held, and returns it.
+ */
+static int sectorcache_evict(struct sectorcache *cache) {
+  while (cache->slots[cache->hand].referenced) {
+    cache->slots[cache->hand].referenced = 0;
+    cache->hand = (cache->hand + 1) % SECTORCACHE_NUM_SLOTS;
+  }
+  int victim = cache->hand;
+  cache->hand = (cache->hand + 1) % SECTORCACHE_NUM_SLOTS;
+
+  struct sectorcache_slot *slot = &cache->slots[victim];
+  if (slot->sector != -1) {
+    int *link = &cache->buckets[sectorcache_bucket(slot->sector)];
+    while (*link != victim) link = &cache->slots[*link].next;
+    *link = slot->next;
+    slot->sector = -1;
+  }
+  return victim;
+}
+
+int sectorcache_readsector(struct sectorcache *cache, int sectorNum, void *buf) {
+  pthread_mutex_lock(&cache->lock);
+  int s = sectorcache_find(cache, sectorNum);
+  if (s != -1) {
+    cache->hits++;
+    cache->slots[s].referenced = 1;
+    memcpy(buf, cache->slots[s].data, DISKIMG_SECTOR_SIZE);
+    pthread_mutex_unlock(&cache->lock);
+    return DISKIMG_SECTOR_SIZE;
+  }
+  cache->misses++;
+  pthread_mutex_unlock(&cache->lock);
+
+  int nread = diskimg_readsector(cache->dfd, sectorNum, buf);
+  if (nread != DISKIMG_SECTOR_SIZE) return nread;
+
+  // Another thread may have cached the sector while we were reading it
+  pthread_mutex_lock(&cache->lock);
+  if (sectorcache_find(cache, sectorNum) != -1) {
+    pthread_mutex_unlock(&cache->lock);
+    return DISKIMG_SECTOR_SIZE;
+  }
+  s = sectorcache_evict(cache);
+  struct sectorcache_slot *slot = &cache->slots[s];
+  memcpy(slot->data, buf, DISKIMG_SECTOR_SIZE);
+  slot->sector = sectorNum;
+  slot->referenced = 0;
+  slot->next = cache->buckets[sectorcache_bucket(sectorNum)];
+  cache->buckets[sectorcache_bucket(sectorNum)] = s;
+  pthread_mutex_unlock(&cache->lock);
+  return DISKIMG_SECTOR_SIZE;
+}
@@ -0,0 +1,58 @@
+#ifndef _SECTORCACHE_H_
+#define _SECTORCACHE_H_
+
+#include <stdint.h>
+#include <pthread.h>
+#include "diskimg.h"
+
+// Number of sectors the cache holds, and the size of its lookup table.
+#define SECTORCACHE_NUM_SLOTS   256
+#define SECTORCACHE_NUM_BUCKETS 512
+
+/**
+ * One cached sector.  Slots are chained by index into the hash bucket of
+ * their sector number.
+ */
+struct sectorcache_slot {
+  int sector;            // sector held, or -1 if the slot is empty
+  int next;              // next slot in the same bucket, or -1
+  int referenced;        // set on every hit; cleared as the clock hand passes
+  uint8_t data[DISKIMG_SECTOR_SIZE];
+};
+
+/**
+ * A fixed-size cache of disk sectors sitting between the filesystem layers
+ * and diskimg_readsector.  Eviction uses the CLOCK algorithm: the hand
+ * sweeps the slots, giving every recently referenced sector a second chance
+ * before it is replaced.  The disk image is assumed not to change while the
+ * cache is in use.  Safe to share between threads: lookups and updates are
+ * made under a mutex, which is released while a miss reads the disk.
+ */
+struct sectorcache {
+  pthread_mutex_t lock;                     // protects everything below but dfd
+  int dfd;                                  // disk image the sectors come from
+  int hand;                                 // next slot the clock hand looks at
+  int buckets[SECTORCACHE_NUM_BUCKETS];     // first slot of each hash chain, or -1
+  struct sectorcache_slot slots[SECTORCACHE_NUM_SLOTS];
+  unsigned long hits;                       // reads served from the cache
+  unsigned long misses;                     // reads that went to the disk image
+};
+
+/**
+ * Initializes an empty cache in front of the given disk image.
+ */
+void sectorcache_init(struct sectorcache *cache, int dfd);
+
+/**
+ * Releases what sectorcache_init set up.  The cache must not be in use.
+ */
+void sectorcache_destroy(struct sectorcache *cache);
+
+/**
+ * Reads the specified sector through the cache.  Same contract as
+ * diskimg_readsector: returns the number of bytes read, or -1 on error.
+ * Sectors that can't be read in full are returned but not cached.
+ */
+int sectorcache_readsector(struct sectorcache *cache, int sectorNum, void *buf);
+
+#endif // _SECTORCACHE_H_
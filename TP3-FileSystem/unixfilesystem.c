@@ -35,11 +35,35 @@ struct unixfilesystem *unixfilesystem_init(int dfd) {
   }
 
   fs->dfd = dfd;  
+  sectorcache_init(&fs->cache, dfd);
   if (diskimg_readsector(dfd, SUPERBLOCK_SECTOR, &fs->superblock) != DISKIMG_SECTOR_SIZE) {
     fprintf(stderr, "Error reading superblock\n");
+    sectorcache_destroy(&fs->cache);
     free(fs);
     return NULL;
   }
 
   return fs;
 }
+
+const void *unixfilesystem_getsector(struct unixfilesystem *fs, int sectorNum, void *buf) {
+  const void *sector = diskimg_getsector_ptr(fs->dfd, sectorNum);
+  if (sector != NULL) return sector;
+  if (sectorcache_readsector(&fs->cache, sectorNum, buf) != DISKIMG_SECTOR_SIZE) return NULL;
+  return buf;
+}
+
+const void *unixfilesystem_getsectors(struct unixfilesystem *fs, int first, int count, void *buf) {
+  if (count == 1) return unixfilesystem_getsector(fs, first, buf);
+
+  // The mapping is contiguous, so the run can be served from it in place
+  // as long as its last sector is mapped too
+  const void *sectors = diskimg_getsector_ptr(fs->dfd, first);
+  if (sectors != NULL && diskimg_getsector_ptr(fs->dfd, first + count - 1) != NULL) return sectors;
+  if (diskimg_readsectors(fs->dfd, first, count, buf) != count * DISKIMG_SECTOR_SIZE) return NULL;
+  return buf;
+}
+
+int unixfilesystem_readsector(struct unixfilesystem *fs, int sectorNum, void *buf) {
+  return sectorcache_readsector(&fs->cache, sectorNum, buf);
+}
@@ -8,6 +8,7 @@
 #include "filsys.h"     // Superblock definition
 #include "ino.h"        // Inode definition
 #include "direntv6.h"   // Directory entry
+#include "sectorcache.h" // Sector cache in front of the diskimg
 
 /**
  * The layout of the Unix disk looked as follows:
@@ -28,8 +29,34 @@
 struct unixfilesystem {
   int dfd; // Handle from the diskimg module to read the diskimg.
   struct filsys superblock;  // The superblock read from the diskimage.
+  struct sectorcache cache;  // Recently read sectors; read through unixfilesystem_readsector.
 };
 
 struct unixfilesystem *unixfilesystem_init(int fd);
 
+/**
+ * Reads the specified sector of the filesystem's disk image through its
+ * sector cache.  Returns the number of bytes read, or -1 on error.
+ */
+int unixfilesystem_readsector(struct unixfilesystem *fs, int sectorNum, void *buf);
+
+/**
+ * Returns a pointer to the contents of the specified sector: straight into
+ * the disk image when it is memory mapped, otherwise into buf, which must
+ * hold DISKIMG_SECTOR_SIZE bytes and is filled through the sector cache.
+ * Returns NULL if the full sector can't be read, which includes a sector
+ * that reaches past the end of the image: unlike diskimg_readsector, a
+ * short read is an error here.
+ */
+const void *unixfilesystem_getsector(struct unixfilesystem *fs, int sectorNum, void *buf);
+
+/**
+ * Like unixfilesystem_getsector, for count consecutive sectors starting at
+ * first; buf must hold count * DISKIMG_SECTOR_SIZE bytes.  Unmapped runs of
+ * more than one sector are read with a single system call and bypass the
+ * sector cache, which is meant for metadata rather than bulk file data.
+ * Returns NULL unless all count sectors can be read.
+ */
+const void *unixfilesystem_getsectors(struct unixfilesystem *fs, int first, int count, void *buf);
+
 #endif // _UNIXFILESYSTEM_H_
@@ -1,6 +1,8 @@
 #include <mutex>
 #include "Semaphore.h"
 #include <condition_variable>
+#include <thread>
+#include <algorithm>
 
 /**
  * @brief Constructs a Semaphore object with the specified initial count.
@@ -39,3 +41,108 @@ void Semaphore::wait()
     condition_.wait(mutex_, [this](){return count_ > 0;});
     count_--;
 }
+
+// Bounds for the adaptive spin phase of SpinSemaphore::wait
+static const int kMinSpin = 16;
+static const int kMaxSpin = 4096;
+
+/**
+ * Tells the CPU we are in a spin loop, which saves power and frees
+ * execution resources for a sibling hyperthread.
+ */
+static inline void cpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#else
+    this_thread::yield();
+#endif
+}
+
+/**
+ * @brief Constructs a SpinSemaphore object with the specified initial count.
+ *
+ * @param count The initial count of the semaphore.
+ */
+SpinSemaphore::SpinSemaphore(int count) : count_(count), sleepers_(0), spinLimit_(kMinSpin) {}
+
+/**
+ * Signals the semaphore, allowing one waiting thread to proceed.  The
+ * mutex is only taken when a thread is asleep and needs a notification.
+ */
+void SpinSemaphore::signal()
+{
+    count_.fetch_add(1);
+    if (sleepers_.load() > 0) {
+        lock_guard<mutex> lg(mutex_);
+        condition_.notify_one();
+    }
+}
+
+/**
+ * @brief Waits until the semaphore is available and then acquires it.
+ *
+ * Spins for up to the current spin budget before blocking.
+ */
+void SpinSemaphore::wait()
+{
+    if (spin()) return;
+
+    unique_lock<mutex> ul(mutex_);
+    sleepers_.fetch_add(1);
+    condition_.wait(ul, [this](){return tryAcquire();});
+    sleepers_.fetch_sub(1);
+}
+
+/**
+ * @brief Like wait(), but gives up after the specified timeout.
+ *
+ * @return true if the semaphore was acquired, false if the wait timed out.
+ */
+bool SpinSemaphore::waitFor(chrono::milliseconds timeout)
+{
+    if (spin()) return true;
+
+    unique_lock<mutex> ul(mutex_);
+    sleepers_.fetch_add(1);
+    bool acquired = condition_.wait_for(ul, timeout, [this](){return tryAcquire();});
+    sleepers_.fetch_sub(1);
+    return acquired;
+}
+
+/**
+ * Spins for up to the current spin budget trying to acquire the
+ * semaphore, and adapts the budget to how that went.  On a single CPU the
+ * signalling thread cannot run while we spin, so this gives up at once.
+ */
+bool SpinSemaphore::spin()
+{
+    static const bool canSpin = thread::hardware_concurrency() > 1;
+    if (!canSpin) return false;
+
+    int limit = spinLimit_.load(memory_order_relaxed);
+    for (int i = 0; i < limit; i++) {
+        if (tryAcquire()) {
+            spinLimit_.store(min(limit * 2, kMaxSpin), memory_order_relaxed);
+            return true;
+        }
+        cpuRelax();
+    }
+    spinLimit_.store(max(limit / 2, kMinSpin), memory_order_relaxed);
+    return false;
+}
+
+/**
+ * Decrements the count if it is positive, without blocking.  Returns
+ * whether it did.
+ */
+bool SpinSemaphore::tryAcquire()
+{
+    int count = count_.load();
+    while (count > 0) {
+        if (count_.compare_exchange_weak(count, count - 1)) return true;
+    }
+    return false;
+}
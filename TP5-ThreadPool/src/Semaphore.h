@@ -3,6 +3,8 @@
 
 #include <condition_variable>
 #include <mutex>
+#include <atomic>
+#include <chrono>
 
 using namespace std;
 
@@ -31,4 +33,38 @@ class Semaphore
         Semaphore& operator=(const Semaphore& orig) = delete;   // no copy assignment
 };
 
+/**
+ * @class SpinSemaphore
+ * @brief A semaphore that spins briefly before putting the caller to sleep.
+ *
+ * The count is atomic, so signal() only touches the mutex and condition
+ * variable when some thread is actually asleep in wait(), and wait() first
+ * spins for a bounded number of iterations in case the signal is only
+ * microseconds away.  The spin budget adapts: it grows whenever spinning
+ * pays off and shrinks whenever the caller ends up sleeping anyway.
+ */
+class SpinSemaphore
+{
+    public:
+
+        SpinSemaphore(int count = 0);
+        void signal();
+        void wait();
+        bool waitFor(chrono::milliseconds timeout);
+
+    private:
+
+        bool tryAcquire();
+        bool spin();
+
+        atomic<int> count_;
+        atomic<int> sleepers_;                  // threads blocked on condition_
+        atomic<int> spinLimit_;                 // current spin budget, in iterations
+        mutex mutex_;
+        condition_variable_any condition_;
+
+        SpinSemaphore(const SpinSemaphore& orig) = delete;              // no copy constructor
+        SpinSemaphore& operator=(const SpinSemaphore& orig) = delete;   // no copy assignment
+};
+
 #endif
@@ -0,0 +1,92 @@
+/**
+ * File: affinity.cc
+ * -----------------
+ * Presents the implementation of the CPU and NUMA placement helpers.
+ */
+
+#include "affinity.h"
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <sched.h>
+#include <unistd.h>
+using namespace std;
+
+/**
+ * Parses a kernel CPU list such as "0-3,8,10-11" into the CPUs it names.
+ */
+static vector<int> parseCpuList(const string& list) {
+    vector<int> cpus;
+    stringstream ss(list);
+    string range;
+    while (getline(ss, range, ',')) {
+        if (range.empty()) continue;
+        size_t dash = range.find('-');
+        int first = stoi(range.substr(0, dash));
+        int last = dash == string::npos ? first : stoi(range.substr(dash + 1));
+        for (int cpu = first; cpu <= last; cpu++) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+static bool readCpuList(const string& path, vector<int>& cpus) {
+    ifstream in(path);
+    string list;
+    if (!in || !getline(in, list)) return false;
+    cpus = parseCpuList(list);
+    return true;
+}
+
+int numaNodeCount() {
+    int nodes = 0;
+    vector<int> cpus;
+    while (readCpuList("/sys/devices/system/node/node" + to_string(nodes) + "/cpulist", cpus)) {
+        nodes++;
+    }
+    return nodes == 0 ? 1 : nodes;
+}
+
+vector<int> numaNodeCpus(int node) {
+    vector<int> cpus;
+    if (readCpuList("/sys/devices/system/node/node" + to_string(node) + "/cpulist", cpus)) {
+        return cpus;
+    }
+
+    // No NUMA information: node 0 is the whole machine
+    if (node == 0 && readCpuList("/sys/devices/system/cpu/online", cpus)) {
+        return cpus;
+    }
+    if (node == 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        for (long cpu = 0; cpu < online; cpu++) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+vector<int> numaCpuToNode() {
+    vector<int> cpuToNode;
+    int nodes = numaNodeCount();
+    for (int node = 0; node < nodes; node++) {
+        vector<int> cpus = numaNodeCpus(node);
+        for (size_t i = 0; i < cpus.size(); i++) {
+            if (cpus[i] >= (int)cpuToNode.size()) cpuToNode.resize(cpus[i] + 1, 0);
+            cpuToNode[cpus[i]] = node;
+        }
+    }
+    return cpuToNode;
+}
+
+bool pinThread(pthread_t thread, const vector<int>& cpus) {
+    if (cpus.empty()) return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (size_t i = 0; i < cpus.size(); i++) {
+        if (cpus[i] < 0 || cpus[i] >= CPU_SETSIZE) return false;
+        CPU_SET(cpus[i], &set);
+    }
+    return pthread_setaffinity_np(thread, sizeof(set), &set) == 0;
+}
@@ -0,0 +1,42 @@
+/**
+ * File: affinity.h
+ * ----------------
+ * Helpers to discover the machine's NUMA layout and pin threads to CPUs,
+ * used by the ThreadPool to place its workers.  The layout is read from
+ * /sys/devices/system/node; on machines that don't expose it, everything
+ * is reported as a single node holding every online CPU.
+ */
+
+#ifndef _affinity_
+#define _affinity_
+
+#include <vector>      // for vector
+#include <pthread.h>   // for pthread_t
+
+using namespace std;
+
+/**
+ * Returns the number of NUMA nodes, at least 1.
+ */
+int numaNodeCount();
+
+/**
+ * Returns the CPUs that belong to the given NUMA node, or an empty vector
+ * if there is no such node.
+ */
+vector<int> numaNodeCpus(int node);
+
+/**
+ * Returns a table mapping every CPU number to the NUMA node it belongs
+ * to.  Reading the layout is slow, so callers build this once and index it
+ * with sched_getcpu() afterwards.
+ */
+vector<int> numaCpuToNode();
+
+/**
+ * Restricts the thread to run only on the given CPUs.  Returns false if
+ * the list is empty or the kernel rejects it.
+ */
+bool pinThread(pthread_t thread, const vector<int>& cpus);
+
+#endif
@@ -0,0 +1,304 @@
+/**
+ * File: coro-task.h
+ * -----------------
+ * C++20 coroutine support for the ThreadPool.  A Task<T> is a lazily
+ * started coroutine returning T: it runs when first awaited, and whoever
+ * awaits it is resumed when it finishes.  Inside a task,
+ *
+ *     co_await pool.schedule();
+ *
+ * moves the rest of the coroutine onto a pool worker, so many logical
+ * tasks can be in flight on a fixed set of workers: a task that is
+ * suspended holds no thread.  when_all(pool, tasks) runs a batch of tasks
+ * concurrently on the pool and resumes its awaiter once all of them are
+ * done, and sync_wait(task) runs a task from ordinary code and blocks for
+ * its result.
+ *
+ * Requires -std=c++20; the rest of the pool builds as C++11.
+ */
+
+#ifndef _coro_task_
+#define _coro_task_
+
+#if __cplusplus < 202002L
+#error "coro-task.h requires C++20 (build with -std=c++20)"
+#endif
+
+#include <coroutine>   // for coroutine_handle, suspend_always
+#include <exception>   // for exception_ptr
+#include <optional>    // for optional
+#include <utility>     // for move, exchange
+#include <vector>      // for vector
+#include <atomic>      // for atomic
+#include <mutex>       // for mutex
+#include <condition_variable> // for condition_variable
+#include "thread-pool.h" // for ThreadPool
+
+using namespace std;
+
+template <typename T = void>
+class Task;
+
+namespace coro_detail {
+
+/**
+ * At its final suspend point a task transfers control straight to its
+ * awaiter, if it has one, rather than resuming it from inside its own
+ * frame, so long chains of tasks don't grow the stack.
+ */
+struct final_awaiter_t {
+    bool await_ready() noexcept { return false; }
+    template <typename Promise>
+    coroutine_handle<> await_suspend(coroutine_handle<Promise> handle) noexcept {
+        coroutine_handle<> continuation = handle.promise().continuation;
+        return continuation ? continuation : noop_coroutine();
+    }
+    void await_resume() noexcept {}
+};
+
+struct promise_base_t {
+    coroutine_handle<> continuation;        // coroutine to resume when this one finishes
+    exception_ptr error;                    // exception the body ended with, if any
+
+    suspend_always initial_suspend() noexcept { return {}; }
+    final_awaiter_t final_suspend() noexcept { return {}; }
+    void unhandled_exception() { error = current_exception(); }
+};
+
+template <typename T>
+struct promise_t : promise_base_t {
+    optional<T> value;                      // the co_returned value, once finished
+
+    Task<T> get_return_object();
+    template <typename U>
+    void return_value(U&& result) { value.emplace(forward<U>(result)); }
+    T result() {
+        if (error) rethrow_exception(error);
+        return move(*value);
+    }
+};
+
+template <>
+struct promise_t<void> : promise_base_t {
+    Task<void> get_return_object();
+    void return_void() {}
+    void result() {
+        if (error) rethrow_exception(error);
+    }
+};
+
+/**
+ * A coroutine that starts immediately and frees itself when it ends; the
+ * glue when_all and sync_wait use to run a task without awaiting it from
+ * another task.
+ */
+struct detached_t {
+    struct promise_type {
+        detached_t get_return_object() { return {}; }
+        suspend_never initial_suspend() noexcept { return {}; }
+        suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { terminate(); }
+    };
+};
+
+}
+
+/**
+ * @brief A lazily started coroutine producing a T.
+ *
+ * Move-only.  Awaiting it starts it on the awaiting thread and yields its
+ * result, rethrowing whatever exception its body ended with.  Destroying
+ * a task that was never started, or has finished, frees its frame; a task
+ * must not be destroyed while it is running.
+ */
+template <typename T>
+class Task {
+  public:
+    typedef coro_detail::promise_t<T> promise_type;
+
+    Task() : handle(nullptr) {}
+    Task(Task&& other) noexcept : handle(exchange(other.handle, nullptr)) {}
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            if (handle) handle.destroy();
+            handle = exchange(other.handle, nullptr);
+        }
+        return *this;
+    }
+    ~Task() {
+        if (handle) handle.destroy();
+    }
+
+  /**
+  * Awaiting a task runs it to completion and yields its result.  A task
+  * that has already finished yields its result straight away.
+  */
+    auto operator co_await() noexcept {
+        struct awaiter_t {
+            coroutine_handle<promise_type> handle;
+            bool await_ready() noexcept { return !handle || handle.done(); }
+            coroutine_handle<> await_suspend(coroutine_handle<> awaiting) noexcept {
+                handle.promise().continuation = awaiting;
+                return handle;
+            }
+            T await_resume() { return handle.promise().result(); }
+        };
+        return awaiter_t{handle};
+    }
+
+  /**
+  * Like awaiting the task, but yields nothing and never throws: only
+  * waits for it to finish, leaving its result in place to be read by a
+  * later co_await.
+  */
+    auto whenReady() noexcept {
+        struct awaiter_t {
+            coroutine_handle<promise_type> handle;
+            bool await_ready() noexcept { return !handle || handle.done(); }
+            coroutine_handle<> await_suspend(coroutine_handle<> awaiting) noexcept {
+                handle.promise().continuation = awaiting;
+                return handle;
+            }
+            void await_resume() noexcept {}
+        };
+        return awaiter_t{handle};
+    }
+
+  /**
+  * Returns the result of a finished task, or rethrows its exception, for
+  * code outside a coroutine that knows the task is done.
+  */
+    T result() { return handle.promise().result(); }
+
+  private:
+    friend struct coro_detail::promise_t<T>;
+    explicit Task(coroutine_handle<promise_type> handle) : handle(handle) {}
+
+    coroutine_handle<promise_type> handle;  // the coroutine frame, owned
+};
+
+template <typename T>
+Task<T> coro_detail::promise_t<T>::get_return_object() {
+    return Task<T>(coroutine_handle<promise_t<T>>::from_promise(*this));
+}
+
+inline Task<void> coro_detail::promise_t<void>::get_return_object() {
+    return Task<void>(coroutine_handle<promise_t<void>>::from_promise(*this));
+}
+
+namespace coro_detail {
+
+/**
+ * Shared by a when_all and the tasks it launched.  The count starts one
+ * above the number of tasks so the awaiter can finish launching them
+ * before any completion is allowed to resume it.
+ */
+struct when_all_state_t {
+    atomic<size_t> remaining;               // unfinished tasks, plus one while launching
+    coroutine_handle<> awaiting;            // the when_all coroutine
+
+    explicit when_all_state_t(size_t n) : remaining(n + 1) {}
+    // Returns true if the caller accounted for the last outstanding piece
+    bool arrive() { return --remaining == 0; }
+};
+
+template <typename T>
+detached_t runOnPool(ThreadPool& pool, Task<T>& task, when_all_state_t& state) {
+    // If the pool is shut down under us, start the task right here: its
+    // own co_awaits on the pool then fail it, and when_all rethrows that
+    try {
+        co_await pool.schedule();
+    } catch (...) {}
+    co_await task.whenReady();
+    if (state.arrive()) state.awaiting.resume();
+}
+
+template <typename T>
+struct when_all_ready_t {
+    ThreadPool& pool;
+    vector<Task<T>>& tasks;
+    when_all_state_t state;
+
+    when_all_ready_t(ThreadPool& pool, vector<Task<T>>& tasks) : pool(pool), tasks(tasks), state(tasks.size()) {}
+    bool await_ready() noexcept { return tasks.empty(); }
+    bool await_suspend(coroutine_handle<> awaiting) {
+        state.awaiting = awaiting;
+        for (size_t i = 0; i < tasks.size(); i++) {
+            runOnPool(pool, tasks[i], state);
+        }
+        // If every task already finished, carry on without suspending
+        return !state.arrive();
+    }
+    void await_resume() noexcept {}
+};
+
+}
+
+/**
+ * Runs every task concurrently on the pool's workers and yields their
+ * results in the order given, once all of them have finished.  If any of
+ * them threw, rethrows the exception of the first such task in the list.
+ */
+template <typename T>
+Task<vector<T>> when_all(ThreadPool& pool, vector<Task<T>> tasks) {
+    co_await coro_detail::when_all_ready_t<T>(pool, tasks);
+    vector<T> results;
+    results.reserve(tasks.size());
+    for (size_t i = 0; i < tasks.size(); i++) {
+        results.push_back(co_await tasks[i]);
+    }
+    co_return results;
+}
+
+/**
+ * Runs every task concurrently on the pool's workers, finishing once all
+ * of them have.  Rethrows the exception of the first task that threw.
+ */
+inline Task<void> when_all(ThreadPool& pool, vector<Task<void>> tasks) {
+    co_await coro_detail::when_all_ready_t<void>(pool, tasks);
+    for (size_t i = 0; i < tasks.size(); i++) {
+        co_await tasks[i];
+    }
+}
+
+namespace coro_detail {
+
+struct sync_wait_state_t {
+    mutex lock;
+    condition_variable finished;
+    bool done = false;
+};
+
+template <typename T>
+detached_t runAndSignal(Task<T>& task, sync_wait_state_t& state) {
+    co_await task.whenReady();
+    // Notify under the lock: once it is released the waiter may return
+    // and destroy the state
+    lock_guard<mutex> lg(state.lock);
+    state.done = true;
+    state.finished.notify_all();
+}
+
+}
+
+/**
+ * Runs the task, blocking the calling thread until it finishes, and
+ * returns its result or rethrows its exception.  The task starts on the
+ * calling thread and continues wherever its co_awaits take it, so it
+ * should co_await pool.schedule() first to do its work on the pool.
+ * Must not be called from a pool worker that the task needs to make
+ * progress.
+ */
+template <typename T>
+T sync_wait(Task<T> task) {
+    coro_detail::sync_wait_state_t state;
+    coro_detail::runAndSignal(task, state);
+    {
+        unique_lock<mutex> ul(state.lock);
+        state.finished.wait(ul, [&state] { return state.done; });
+    }
+    return task.result();
+}
+
+#endif
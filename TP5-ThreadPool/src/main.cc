@@ -1,4 +1,5 @@
 #include "thread-pool.h"
+#include "parallel.h"
 #include <iostream>
 #include <vector>
 #include <numeric>  // For std::accumulate
@@ -7,9 +8,9 @@
 using namespace std;
 
 // Function to compute the sum of a subvector
-void computeSum(const vector<int>& data, int start, int end, int* result) {
+int computeSum(const vector<int>& data, int start, int end) {
 
-    *result = accumulate(data.begin() + start, data.begin() + end, 0);
+    return accumulate(data.begin() + start, data.begin() + end, 0);
 }
 
 int main() {
@@ -18,30 +19,12 @@ int main() {
     int numThreads = 3;
     ThreadPool pool(numThreads);
 
-    // Results vector to hold the sums computed by each thread
-    vector<int> results(numThreads, 0);
-
-    // Determine the size of each chunk of data to process
+    // Let parallel_reduce pick the chunks and balance them across the workers
     int n = data.size();
-    int chunkSize = (n + numThreads - 1) / numThreads;  // Ensure all data is covered
-
-    // Schedule tasks in the ThreadPool
-    for (int i = 0; i < numThreads; ++i) {
-        int start = i * chunkSize;
-        int end = min(start + chunkSize, n);
-        if (start < n) {
-            // schedule the task with lambda function
-            /* lambdas : [capture list] (parameters) -> return type {function body} */
-            pool.schedule([start, end, i, &data, &results](void)-> void {computeSum(data, start, end, &results[i]);});
-            //pool.schedule([start, end, i, &data, &results](){computeSum(data, start, end, &results[i]);});
-        }
-    }
-
-    // Wait for all threads to finish
-    pool.wait();
+    int totalSum = parallel_reduce(pool, 0, n, 0,
+        [&data](int start, int end, int partial) { return partial + computeSum(data, start, end); },
+        [](int a, int b) { return a + b; });
 
-    // Calculate total sum
-    int totalSum = accumulate(results.begin(), results.end(), 0);
     cout << "Total sum of elements: " << totalSum << endl;
 
     return 0;
@@ -0,0 +1,140 @@
+/**
+ * File: mpmc-ring.h
+ * -----------------
+ * Defines the MpmcRing class template, a bounded lock-free queue that any
+ * number of threads may push to and pop from concurrently.  It is Dmitry
+ * Vyukov's array-based design: every cell carries a sequence number that
+ * tells producers and consumers whether it is free, full, or still being
+ * written, so the only shared read-modify-write is a CAS on the enqueue or
+ * dequeue position.
+ *
+ * The ring never allocates after construction.  When it is full, push fails
+ * and the caller decides where the element goes instead.
+ */
+
+#ifndef _mpmc_ring_
+#define _mpmc_ring_
+
+#include <cstddef>     // for size_t
+#include <cstdint>     // for intptr_t
+#include <vector>      // for vector
+#include <atomic>      // for atomic
+#include <utility>     // for move
+
+using namespace std;
+
+template <typename T>
+class MpmcRing {
+  public:
+
+  /**
+  * Constructs an empty ring holding up to the specified number of
+  * elements, rounded up to a power of two.
+  */
+    MpmcRing(size_t capacity) : cells(roundUp(capacity)), mask(cells.size() - 1),
+                                enqueuePos(0), dequeuePos(0) {
+        for (size_t i = 0; i < cells.size(); i++) {
+            cells[i].sequence.store(i, memory_order_relaxed);
+        }
+    }
+
+  /**
+  * Moves the element into the ring.  Returns false, leaving the element
+  * untouched, if the ring is full.  On success, wasEmpty is set when every
+  * element pushed before this one had already been claimed by a consumer.
+  */
+    bool push(T& elem, bool& wasEmpty) {
+        size_t pos = enqueuePos.load(memory_order_relaxed);
+        cell_t *cell;
+        while (true) {
+            cell = &cells[pos & mask];
+            size_t seq = cell->sequence.load(memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if (diff == 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                return false;               // the cell a full lap behind us is still occupied
+            } else {
+                pos = enqueuePos.load(memory_order_relaxed);
+            }
+        }
+        cell->data = move(elem);
+        cell->sequence.store(pos + 1, memory_order_seq_cst);
+        wasEmpty = dequeuePos.load(memory_order_seq_cst) == pos;
+        return true;
+    }
+
+  /**
+  * Moves the oldest element out of the ring.  Returns false if there is
+  * no published element to take.
+  */
+    bool pop(T& elem) {
+        size_t pos = dequeuePos.load(memory_order_relaxed);
+        cell_t *cell;
+        while (true) {
+            cell = &cells[pos & mask];
+            size_t seq = cell->sequence.load(memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+            if (diff == 0) {
+                if (dequeuePos.compare_exchange_weak(pos, pos + 1, memory_order_seq_cst)) break;
+            } else if (diff < 0) {
+                return false;               // nothing published at the head yet
+            } else {
+                pos = dequeuePos.load(memory_order_relaxed);
+            }
+        }
+        elem = move(cell->data);
+        cell->data = T();                   // release whatever the element captured
+        cell->sequence.store(pos + mask + 1, memory_order_release);
+        return true;
+    }
+
+  /**
+  * Returns true if the cell at the head of the ring holds no published
+  * element.  Like any size query on a concurrent queue, it is only a hint.
+  */
+    bool empty() const {
+        size_t pos = dequeuePos.load(memory_order_seq_cst);
+        return cells[pos & mask].sequence.load(memory_order_seq_cst) != pos + 1;
+    }
+
+  /**
+  * Returns the number of claimed positions not yet consumed, which may
+  * include elements still being written.  Only a hint.
+  */
+    size_t size() const {
+        size_t dequeued = dequeuePos.load(memory_order_relaxed);
+        size_t enqueued = enqueuePos.load(memory_order_relaxed);
+        return enqueued > dequeued ? enqueued - dequeued : 0;
+    }
+
+  private:
+
+    struct cell_t {
+        atomic<size_t> sequence;            // pos when free, pos + 1 when holding the element for pos
+        T data;
+
+        cell_t() : sequence(0) {}
+    };
+
+    static size_t roundUp(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) size <<= 1;
+        return size;
+    }
+
+    vector<cell_t> cells;                   // circular storage, size is a power of two
+    size_t mask;                            // cells.size() - 1
+
+    // Pad the two hot positions onto separate cache lines
+    char pad0[64];
+    atomic<size_t> enqueuePos;              // next position a producer will claim
+    char pad1[64 - sizeof(atomic<size_t>)];
+    atomic<size_t> dequeuePos;              // next position a consumer will claim
+    char pad2[64 - sizeof(atomic<size_t>)];
+
+    MpmcRing(const MpmcRing& original) = delete;
+    MpmcRing& operator=(const MpmcRing& rhs) = delete;
+};
+
+#endif
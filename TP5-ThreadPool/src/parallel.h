@@ -0,0 +1,134 @@
+/**
+ * File: parallel.h
+ * ----------------
+ * Defines parallel_for and parallel_reduce, data-parallel loops built on
+ * top of the ThreadPool.
+ *
+ * The range [begin, end) is cut into grain-sized chunks, and the chunks
+ * are split recursively in halves: the calling thread keeps the left half
+ * and schedules the right one.  Idle workers therefore steal the biggest
+ * remaining subranges, which balances skewed work without any static
+ * assignment of chunks to threads.  Each call waits on its own TaskGroup,
+ * so it never waits on unrelated work, and may be used from inside a
+ * running thunk.
+ */
+
+#ifndef _parallel_
+#define _parallel_
+
+#include <cstddef>     // for size_t
+#include <vector>      // for vector
+#include "thread-pool.h" // for ThreadPool
+#include "task-group.h" // for TaskGroup
+
+using namespace std;
+
+/**
+ * Runs runChunk(c) for every chunk index c in [first, last), scheduling
+ * the right half of the range and recursing into the left one.
+ */
+template <typename Chunk>
+void fork_chunks(TaskGroup& group, size_t first, size_t last, const Chunk& runChunk) {
+    while (last - first > 1) {
+        size_t mid = first + (last - first) / 2;
+        group.schedule([&group, mid, last, &runChunk] {
+            fork_chunks(group, mid, last, runChunk);
+        });
+        last = mid;
+    }
+    if (first < last) runChunk(first);
+}
+
+/**
+ * Picks a grain that yields about eight chunks per worker: enough for
+ * stealing to even out skewed work, few enough to keep overhead low.
+ */
+template <typename Index>
+Index parallel_grain(ThreadPool& pool, Index begin, Index end) {
+    size_t chunks = 8 * (pool.size() == 0 ? 1 : pool.size());
+    size_t grain = ((size_t)(end - begin) + chunks - 1) / chunks;
+    return (Index)(grain == 0 ? 1 : grain);
+}
+
+/**
+ * Calls body(lo, hi) over subranges that exactly cover [begin, end), each
+ * at most grain elements long, and returns once all of them have run.  If
+ * any call throws, the first exception is rethrown here.
+ */
+template <typename Index, typename Body>
+void parallel_for(ThreadPool& pool, Index begin, Index end, Index grain, const Body& body) {
+    if (!(begin < end)) return;
+    if (grain < 1) grain = 1;
+    size_t numChunks = ((size_t)(end - begin) + grain - 1) / grain;
+    auto runChunk = [begin, end, grain, &body](size_t chunk) {
+        Index lo = begin + (Index)(chunk * grain);
+        Index hi = end - lo > grain ? lo + grain : end;
+        body(lo, hi);
+    };
+
+    TaskGroup group(pool);
+    fork_chunks(group, 0, numChunks, runChunk);
+    group.wait();
+}
+
+/**
+ * Same as above, choosing the grain automatically.
+ */
+template <typename Index, typename Body>
+void parallel_for(ThreadPool& pool, Index begin, Index end, const Body& body) {
+    parallel_for(pool, begin, end, parallel_grain(pool, begin, end), body);
+}
+
+/**
+ * One chunk's partial result in parallel_reduce.  Every chunk writes its
+ * own object, padded onto its own cache line, rather than an element of a
+ * vector<T>, which for T = bool packs the partials into shared words.
+ */
+template <typename T>
+struct reduce_partial_t {
+    T value;
+    char pad[64];
+
+    explicit reduce_partial_t(const T& value) : value(value) {}
+};
+
+/**
+ * Folds [begin, end) into a single value.  body(lo, hi, acc) folds one
+ * subrange into acc, which starts as identity, and returns the result;
+ * combine(a, b) merges two partial results.  Partial results are combined
+ * in range order, so combine only has to be associative, not commutative.
+ */
+template <typename Index, typename T, typename Body, typename Combine>
+T parallel_reduce(ThreadPool& pool, Index begin, Index end, Index grain, const T& identity,
+                  const Body& body, const Combine& combine) {
+    if (!(begin < end)) return identity;
+    if (grain < 1) grain = 1;
+    size_t numChunks = ((size_t)(end - begin) + grain - 1) / grain;
+    vector<reduce_partial_t<T>> partials(numChunks, reduce_partial_t<T>(identity));
+    auto runChunk = [begin, end, grain, &body, &partials](size_t chunk) {
+        Index lo = begin + (Index)(chunk * grain);
+        Index hi = end - lo > grain ? lo + grain : end;
+        partials[chunk].value = body(lo, hi, partials[chunk].value);
+    };
+
+    TaskGroup group(pool);
+    fork_chunks(group, 0, numChunks, runChunk);
+    group.wait();
+
+    T result = partials[0].value;
+    for (size_t i = 1; i < numChunks; i++) {
+        result = combine(result, partials[i].value);
+    }
+    return result;
+}
+
+/**
+ * Same as above, choosing the grain automatically.
+ */
+template <typename Index, typename T, typename Body, typename Combine>
+T parallel_reduce(ThreadPool& pool, Index begin, Index end, const T& identity,
+                  const Body& body, const Combine& combine) {
+    return parallel_reduce(pool, begin, end, parallel_grain(pool, begin, end), identity, body, combine);
+}
+
+#endif
@@ -0,0 +1,54 @@
+/**
+ * File: pool-stats.cc
+ * -------------------
+ * Presents the implementation of the ThreadPool statistics helpers.
+ */
+
+#include "pool-stats.h"
+using namespace std;
+
+uint64_t LatencyHistogram::count() const {
+    uint64_t total = 0;
+    for (size_t i = 0; i < buckets.size(); i++) {
+        total += buckets[i];
+    }
+    return total;
+}
+
+chrono::nanoseconds LatencyHistogram::percentile(double p) const {
+    uint64_t total = count();
+    if (total == 0) return chrono::nanoseconds(0);
+    uint64_t target = (uint64_t)(p / 100.0 * total);
+    if (target == 0) target = 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets.size(); i++) {
+        seen += buckets[i];
+        if (seen >= target) return chrono::nanoseconds((uint64_t)1 << (i + 1));
+    }
+    return chrono::nanoseconds((uint64_t)1 << buckets.size());
+}
+
+static long long micros(chrono::nanoseconds d) {
+    return chrono::duration_cast<chrono::microseconds>(d).count();
+}
+
+ostream& operator<<(ostream& os, const ThreadPoolStats& stats) {
+    os << "queued=" << stats.queueDepth
+       << " outstanding=" << stats.outstanding
+       << " workers=" << stats.liveWorkers
+       << " idle=" << stats.idleWorkers
+       << " executed=" << stats.executed
+       << " steals=" << stats.steals
+       << " dropped=" << stats.dropped
+       << " failed=" << stats.failed
+       << " wait_p50_us=" << micros(stats.queueWait.percentile(50))
+       << " wait_p99_us=" << micros(stats.queueWait.percentile(99))
+       << " run_p50_us=" << micros(stats.runTime.percentile(50))
+       << " run_p99_us=" << micros(stats.runTime.percentile(99));
+    for (size_t i = 0; i < stats.workers.size(); i++) {
+        os << " w" << i << ".executed=" << stats.workers[i].executed
+           << " w" << i << ".busy_us=" << micros(stats.workers[i].busyTime)
+           << " w" << i << ".idle_us=" << micros(stats.workers[i].idleTime);
+    }
+    return os;
+}
@@ -0,0 +1,114 @@
+/**
+ * File: pool-stats.h
+ * ------------------
+ * Defines the counters each ThreadPool worker keeps about itself and the
+ * snapshot types the pool's stats() call assembles from them.
+ *
+ * Every counter has exactly one writer, the worker that owns it, which
+ * bumps it with a relaxed load and store; readers only ever see slightly
+ * stale values.  That keeps instrumentation off the shared cache lines
+ * and away from any lock on the scheduling path.
+ */
+
+#ifndef _pool_stats_
+#define _pool_stats_
+
+#include <cstddef>     // for size_t
+#include <cstdint>     // for uint64_t
+#include <atomic>      // for atomic
+#include <vector>      // for vector
+#include <chrono>      // for nanoseconds
+#include <ostream>     // for ostream
+
+using namespace std;
+
+// Histogram bucket i counts durations in [2^i, 2^(i+1)) nanoseconds; the
+// last bucket also takes everything longer
+static const size_t kLatencyBuckets = 32;
+
+/**
+ * @brief A log2-bucketed histogram of durations.
+ */
+struct LatencyHistogram {
+    vector<uint64_t> buckets;               // counts per bucket, see kLatencyBuckets
+
+    LatencyHistogram() : buckets(kLatencyBuckets, 0) {}
+
+    /**
+    * Returns the number of samples recorded.
+    */
+    uint64_t count() const;
+
+    /**
+    * Returns an upper bound on the given percentile (0 to 100): the top
+    * of the bucket the percentile falls in, or zero with no samples.
+    */
+    chrono::nanoseconds percentile(double p) const;
+};
+
+/**
+ * @brief What one worker has done so far.
+ */
+struct WorkerStats {
+    size_t executed;                        // thunks run
+    size_t steals;                          // thunks taken from a peer's deque
+    chrono::nanoseconds busyTime;           // time spent running thunks
+    chrono::nanoseconds idleTime;           // time spent looking for work or parked
+};
+
+/**
+ * @brief A snapshot of a ThreadPool's state and history, from stats().
+ *
+ * Times are only collected when the pool was built with collectStats
+ * set; otherwise the histograms are empty and busy/idle times are zero.
+ */
+struct ThreadPoolStats {
+    size_t queueDepth;                      // thunks queued and not yet started
+    size_t outstanding;                     // thunks scheduled and not yet finished
+    size_t liveWorkers;                     // worker threads running
+    size_t idleWorkers;                     // workers parked waiting for work
+    size_t executed;                        // thunks run by workers, all time
+    size_t steals;                          // thunks stolen between workers, all time
+    size_t dropped;                         // thunks evicted from a full queue, all time
+    size_t failed;                          // thunks that threw, all time
+    LatencyHistogram queueWait;             // time from schedule to start
+    LatencyHistogram runTime;               // time from start to finish
+    vector<WorkerStats> workers;            // one entry per worker slot
+};
+
+/**
+ * Prints the snapshot as a single line of space-separated key=value
+ * pairs, with times in microseconds, so it can be parsed and diffed.
+ */
+ostream& operator<<(ostream& os, const ThreadPoolStats& stats);
+
+/**
+ * @brief The live counters behind WorkerStats, owned by one worker.
+ */
+struct worker_counters_t {
+    atomic<uint64_t> steals;
+    atomic<uint64_t> busyNanos;
+    atomic<uint64_t> idleNanos;
+    atomic<uint64_t> waitBuckets[kLatencyBuckets];
+    atomic<uint64_t> runBuckets[kLatencyBuckets];
+
+    worker_counters_t() : steals(0), busyNanos(0), idleNanos(0) {
+        for (size_t i = 0; i < kLatencyBuckets; i++) {
+            waitBuckets[i] = 0;
+            runBuckets[i] = 0;
+        }
+    }
+
+    // Single-writer increment: no read-modify-write needed
+    static void add(atomic<uint64_t>& counter, uint64_t value) {
+        counter.store(counter.load(memory_order_relaxed) + value, memory_order_relaxed);
+    }
+
+    static void record(atomic<uint64_t> *buckets, uint64_t nanos) {
+        size_t bucket = 0;
+        while (bucket + 1 < kLatencyBuckets && (nanos >> (bucket + 1)) != 0) bucket++;
+        add(buckets[bucket], 1);
+    }
+};
+
+#endif
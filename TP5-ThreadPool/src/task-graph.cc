@@ -0,0 +1,113 @@
+/**
+ * File: task-graph.cc
+ * -------------------
+ * Presents the implementation of the TaskGraph class.
+ */
+
+#include "task-graph.h"
+#include <stdexcept>
+using namespace std;
+
+TaskGraph::TaskGraph(ThreadPool& pool) : group(pool), dirty(true), failed(false) {}
+
+size_t TaskGraph::addNode(function<void(void)> thunk) {
+    node_t node;
+    node.thunk = move(thunk);
+    node.predecessors = 0;
+    nodes.push_back(move(node));
+    dirty = true;
+    return nodes.size() - 1;
+}
+
+void TaskGraph::addEdge(size_t before, size_t after) {
+    if (before >= nodes.size() || after >= nodes.size()) {
+        throw out_of_range("TaskGraph: no such node");
+    }
+    if (before == after) {
+        throw invalid_argument("TaskGraph: a node cannot depend on itself");
+    }
+    nodes[before].successors.push_back(after);
+    nodes[after].predecessors++;
+    dirty = true;
+}
+
+size_t TaskGraph::size() const {
+    return nodes.size();
+}
+
+void TaskGraph::prepare() {
+    // Kahn's algorithm: if peeling off nodes without predecessors doesn't
+    // reach every node, the rest are on a cycle and would never start
+    vector<size_t> inDegree(nodes.size());
+    vector<size_t> ready;
+    for (size_t i = 0; i < nodes.size(); i++) {
+        inDegree[i] = nodes[i].predecessors;
+        if (inDegree[i] == 0) ready.push_back(i);
+    }
+    size_t visited = 0;
+    while (!ready.empty()) {
+        size_t id = ready.back();
+        ready.pop_back();
+        visited++;
+        for (size_t s : nodes[id].successors) {
+            if (--inDegree[s] == 0) ready.push_back(s);
+        }
+    }
+    if (visited != nodes.size()) {
+        throw logic_error("TaskGraph: dependency cycle");
+    }
+
+    remaining.reset(new atomic<size_t>[nodes.size()]);
+    dirty = false;
+}
+
+void TaskGraph::run() {
+    if (dirty) prepare();
+    failed = false;
+    for (size_t i = 0; i < nodes.size(); i++) {
+        remaining[i] = nodes[i].predecessors;
+    }
+    for (size_t i = 0; i < nodes.size(); i++) {
+        if (nodes[i].predecessors == 0) {
+            group.schedule([this, i] { runNode(i); });
+        }
+    }
+    group.wait();
+}
+
+void TaskGraph::runNode(size_t id) {
+    // Of the successors this node releases, one continues on this worker
+    // straight away and the rest are scheduled, so a chain of nodes runs
+    // without a trip through the queues per link
+    while (true) {
+        exception_ptr error;
+        if (!failed) {
+            try {
+                nodes[id].thunk();
+            } catch (...) {
+                failed = true;
+                error = current_exception();
+            }
+        }
+
+        const size_t kNone = nodes.size();
+        size_t next = kNone;
+        for (size_t s : nodes[id].successors) {
+            if (--remaining[s] != 0) continue;
+            if (next != kNone) {
+                group.schedule([this, next] { runNode(next); });
+            }
+            next = s;
+        }
+
+        if (error) {
+            // Hand the exception to the group, which keeps the first one
+            if (next != kNone) {
+                group.schedule([this, next] { runNode(next); });
+            }
+            rethrow_exception(error);
+        }
+        if (next == kNone) return;
+        id = next;
+    }
+}
@@ -0,0 +1,85 @@
+/**
+ * File: task-graph.h
+ * ------------------
+ * Defines the TaskGraph class, which runs thunks with dependencies between
+ * them on a ThreadPool.  Nodes are thunks and edges say which nodes must
+ * finish before another may start.  Instead of a pool-wide wait() between
+ * stages, each node is scheduled the moment its last predecessor finishes,
+ * tracked with an atomic count of unfinished predecessors per node, so a
+ * run takes as long as its critical path rather than the sum of its stages.
+ *
+ * A graph is built once and can then be run any number of times; a run
+ * only resets the counters, it doesn't allocate.
+ */
+
+#ifndef _task_graph_
+#define _task_graph_
+
+#include <cstddef>     // for size_t
+#include <atomic>      // for atomic
+#include <memory>      // for unique_ptr
+#include <vector>      // for vector
+#include <functional>  // for function
+#include "thread-pool.h" // for ThreadPool
+#include "task-group.h" // for TaskGroup
+
+using namespace std;
+
+class TaskGraph {
+  public:
+
+  /**
+  * Constructs an empty graph whose nodes run on the given pool.
+  */
+    TaskGraph(ThreadPool& pool);
+
+  /**
+  * Adds a node that runs the thunk, and returns its ID for use with
+  * addEdge.  IDs are assigned consecutively from zero.
+  */
+    size_t addNode(function<void(void)> thunk);
+
+  /**
+  * Makes node `after` wait for node `before` to finish.  Throws
+  * out_of_range for an unknown node and invalid_argument for an edge from
+  * a node to itself.
+  */
+    void addEdge(size_t before, size_t after);
+
+  /**
+  * Returns the number of nodes in the graph.
+  */
+    size_t size() const;
+
+  /**
+  * Runs every node once, each as soon as all of its predecessors have
+  * finished, and blocks until the whole graph is done.  If a node throws,
+  * nodes that haven't started yet are skipped and the first exception is
+  * rethrown once the run is over.  Throws logic_error, without running
+  * anything, if the edges form a cycle.  A graph must not be run or
+  * modified while a run of it is in progress.
+  */
+    void run();
+
+  private:
+
+    typedef struct node {
+        function<void(void)> thunk;         // the work
+        vector<size_t> successors;          // nodes that wait for this one
+        size_t predecessors;                // number of edges into this node
+    } node_t;
+
+    void prepare();
+    void runNode(size_t id);
+
+    TaskGroup group;                        // tracks a run's scheduled nodes and their exceptions
+    vector<node_t> nodes;                   // the graph, indexed by node ID
+    unique_ptr<atomic<size_t>[]> remaining; // unfinished predecessors of each node during a run
+    bool dirty;                             // nodes changed since remaining was sized and checked
+    atomic<bool> failed;                    // a node of the current run threw
+
+    TaskGraph(const TaskGraph& original) = delete;
+    TaskGraph& operator=(const TaskGraph& rhs) = delete;
+};
+
+#endif
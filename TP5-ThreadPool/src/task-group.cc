@@ -0,0 +1,57 @@
+/**
+ * File: task-group.cc
+ * -------------------
+ * Presents the implementation of the TaskGroup class.
+ */
+
+#include "task-group.h"
+#include <chrono>
+using namespace std;
+
+TaskGroup::TaskGroup(ThreadPool& pool) : pool(pool), pending(0) {}
+
+void TaskGroup::wait() {
+    waitAll();
+
+    exception_ptr e;
+    {
+        lock_guard<mutex> lg(lock);
+        e = error;
+        error = nullptr;
+    }
+    if (e) rethrow_exception(e);
+}
+
+TaskGroup::~TaskGroup() {
+    waitAll();
+}
+
+void TaskGroup::fail(exception_ptr e) {
+    lock_guard<mutex> lg(lock);
+    if (!error) error = e;
+}
+
+void TaskGroup::finish() {
+    // Decrement under the lock so that a waiter that sees zero cannot
+    // destroy the group while we are still using it
+    lock_guard<mutex> lg(lock);
+    if (--pending == 0) {
+        finished.notify_all();
+    }
+}
+
+void TaskGroup::waitAll() {
+    if (pool.isWorkerThread()) {
+        // Blocking here could starve the thunks we are waiting for, so help
+        // run queued work; if there is none, the rest is running on other
+        // workers but may still fork more, so check back shortly
+        while (pending != 0) {
+            if (pool.runPendingTask()) continue;
+            unique_lock<mutex> ul(lock);
+            finished.wait_for(ul, chrono::milliseconds(1), [this] { return pending == 0; });
+        }
+    }
+
+    unique_lock<mutex> ul(lock);
+    finished.wait(ul, [this] { return pending == 0; });
+}
@@ -0,0 +1,100 @@
+/**
+ * File: task-group.h
+ * ------------------
+ * Defines the TaskGroup class, which schedules thunks on a ThreadPool and
+ * lets the caller wait for just those thunks.  Unlike ThreadPool::wait,
+ * which is a barrier over everything scheduled on the pool, a TaskGroup
+ * keeps its own counter, so independent users of one shared pool never end
+ * up waiting on each other's work.
+ */
+
+#ifndef _task_group_
+#define _task_group_
+
+#include <cstddef>     // for size_t
+#include <atomic>      // for atomic
+#include <mutex>       // for mutex
+#include <condition_variable> // for condition_variable
+#include <exception>   // for exception_ptr
+#include <utility>     // for move, forward
+#include <type_traits> // for decay
+#include <stdexcept>   // for runtime_error
+#include "thread-pool.h" // for ThreadPool
+
+using namespace std;
+
+class TaskGroup {
+  public:
+
+  /**
+  * Constructs an empty group whose thunks run on the given pool.
+  */
+    TaskGroup(ThreadPool& pool);
+
+  /**
+  * Schedules the thunk on the pool as part of this group.  If it throws,
+  * the exception is kept and rethrown by wait() instead of escaping into
+  * the worker.  If the pool drops it unrun (shutdownNow, or a DropOldest
+  * pool evicting it), it still counts as finished, and wait() throws a
+  * runtime_error.
+  */
+    template <typename F>
+    void schedule(F&& thunk) {
+        pending++;
+        pool.schedule(group_thunk_t<typename decay<F>::type>(this, forward<F>(thunk)));
+    }
+
+  /**
+  * Blocks until every thunk scheduled through this group has finished,
+  * then rethrows the first exception any of them threw.  When called from
+  * one of the pool's own workers, it runs queued thunks while it waits so
+  * the worker is never stuck waiting on work queued behind it.
+  */
+    void wait();
+
+  /**
+  * Waits for the group's thunks to finish.  Exceptions that were never
+  * collected by wait() are discarded.
+  */
+    ~TaskGroup();
+
+  private:
+
+    template <typename Fn>
+    struct group_thunk_t {
+        TaskGroup *group;
+        Fn fn;
+
+        template <typename F>
+        group_thunk_t(TaskGroup *group, F&& fn) : group(group), fn(forward<F>(fn)) {}
+
+        void operator()() {
+            try {
+                fn();
+            } catch (...) {
+                group->fail(current_exception());
+            }
+            group->finish();
+        }
+
+        void abandon() {
+            group->fail(make_exception_ptr(runtime_error("TaskGroup: thunk dropped by the pool before it ran")));
+            group->finish();
+        }
+    };
+
+    void fail(exception_ptr e);
+    void finish();
+    void waitAll();
+
+    ThreadPool& pool;                       // pool the group's thunks run on
+    atomic<size_t> pending;                 // thunks scheduled but not yet finished
+    mutex lock;                             // protects error and pairs with finished
+    condition_variable finished;            // notified when pending drops to zero
+    exception_ptr error;                    // first exception thrown by a thunk
+
+    TaskGroup(const TaskGroup& original) = delete;
+    TaskGroup& operator=(const TaskGroup& rhs) = delete;
+};
+
+#endif
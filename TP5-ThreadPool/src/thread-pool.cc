@@ -5,61 +5,338 @@
  */
 
 #include "thread-pool.h"
+#include "affinity.h"
+#include <sched.h>
+#include <algorithm>
 using namespace std;
 
-ThreadPool::ThreadPool(size_t numThreads) : wts(numThreads), done(false), activeTasks(0) {
-    // Initialize available workers queue with all worker IDs
-    for (size_t i = 0; i < numThreads; i++) {
-        availableWorkers.push(i);
+// Pool and worker ID of the calling thread, if it is one of our workers
+static thread_local ThreadPool *currentPool = nullptr;
+static thread_local int currentWorker = -1;
+
+// Slots in the lock-free ring before thunks spill into the locked deque
+static const size_t kRingCapacity = 1024;
+
+// Every this many task searches, a worker starts from a rotating lane
+// instead of the highest priority one
+static const size_t kAgingInterval = 8;
+
+// Outcomes of a parked worker's attempt to retire after idling too long
+static const int kRetired = 0;                  // the worker left the pool
+static const int kClaimed = 1;                  // a waker already picked it; a signal is on its way
+static const int kStay = 2;                     // the pool is at its minimum size
+
+ThreadPool::ThreadPool(size_t numThreads) : ThreadPool(ThreadPoolOptions(numThreads)) {}
+
+ThreadPool::ThreadPool(size_t numThreads, QueueBackend backend)
+    : ThreadPool([numThreads, backend] {
+          ThreadPoolOptions options(numThreads);
+          options.backend = backend;
+          return options;
+      }()) {}
+
+ThreadPool::ThreadPool(const ThreadPoolOptions& options)
+    : wts(max(options.numThreads, options.maxThreads)), done(false), numNodes(1), idleWorkers(0),
+      minThreads(options.numThreads), maxThreads(wts.size()), growQueueDepth(options.growQueueDepth),
+      growAfter(options.growAfter), idleTimeout(options.idleTimeout), liveWorkers(0),
+      collectStats(options.collectStats), statsInterval(options.statsInterval), statsStream(options.statsStream),
+      timerStop(false), queueCapacity(options.queueCapacity), overflowPolicy(options.overflowPolicy), queued(0),
+      blockedProducers(0), dropped(0), errorHandler(options.errorHandler), failures(0), outstanding(0), discarding(false), discarded(0) {
+    // Work out where each worker goes before any of them starts
+    bool pinned = !options.cpus.empty() || options.numaNode >= 0 || options.spreadAcrossNodes;
+    if (pinned) {
+        numNodes = numaNodeCount();
+        cpuToNode = numaCpuToNode();
+    }
+    vector<int> nodesWithCpus;
+    for (int node = 0; node < numNodes; node++) {
+        if (!numaNodeCpus(node).empty()) nodesWithCpus.push_back(node);
+    }
+    if (options.numaNode >= numNodes || (options.numaNode >= 0 && numaNodeCpus(options.numaNode).empty())) {
+        throw invalid_argument("ThreadPool: no CPUs on NUMA node " + to_string(options.numaNode));
     }
-    
-    // Create and start worker threads
-    for (size_t i = 0; i < numThreads; i++) {
-        wts[i].ts = thread([this, i] { worker(i); });
+    for (size_t i = 0; i < options.cpus.size(); i++) {
+        int cpu = options.cpus[i];
+        if (cpu < 0 || cpu >= (int)cpuToNode.size() || cpu >= CPU_SETSIZE) {
+            throw invalid_argument("ThreadPool: no such CPU " + to_string(cpu));
+        }
+    }
+    for (size_t i = 0; i < wts.size(); i++) {
+        if (!options.cpus.empty()) {
+            int cpu = options.cpus[i % options.cpus.size()];
+            wts[i].cpus.push_back(cpu);
+            wts[i].node = cpuToNode[cpu];
+        } else if (options.numaNode >= 0) {
+            wts[i].node = options.numaNode;
+            wts[i].cpus = numaNodeCpus(options.numaNode);
+        } else if (options.spreadAcrossNodes && !nodesWithCpus.empty()) {
+            wts[i].node = nodesWithCpus[i % nodesWithCpus.size()];
+            wts[i].cpus = numaNodeCpus(wts[i].node);
+        }
+    }
+
+    // Producers on a node without workers feed the queues of a node that
+    // has some, so their thunks are never left to cross-node stealing alone
+    vector<bool> hasWorkers(numNodes, false);
+    for (size_t i = 0; i < wts.size(); i++) {
+        hasWorkers[wts[i].node] = true;
+    }
+    int fallback = wts.empty() ? 0 : wts[0].node;
+    for (int node = 0; node < numNodes; node++) {
+        homeNode.push_back(hasWorkers[node] ? node : fallback);
+    }
+
+    lanes = vector<lane_t>(numNodes * kNumPriorities);
+    if (options.backend == QueueBackend::LockFree) {
+        for (size_t i = 0; i < lanes.size(); i++) {
+            lanes[i].ring.reset(new MpmcRing<Thunk>(kRingCapacity));
+        }
+    }
+    availableWorkers.reserve(wts.size());
+
+    // Create and start worker threads; each one parks itself until work shows up
+    for (size_t i = 0; i < minThreads; i++) {
+        spawnWorker(i);
+    }
+    if (needsSupervisor()) {
+        st = thread([this] { supervisor(); });
     }
-    
-    // Create and start dispatcher thread
-    dt = thread([this] { dispatcher(); });
 }
 
-void ThreadPool::schedule(const function<void(void)>& thunk) {
-    {
-        lock_guard<mutex> lg(queueLock);
-        taskQueue.push(thunk);
+void ThreadPool::enqueue(Thunk&& task, Priority priority) {
+    if (queueCapacity != 0 && !admit(task)) return;
+    push(move(task), priority);
+}
+
+void ThreadPool::push(Thunk&& task, Priority priority) {
+    // Counted before checking the flag: either shutdownNow's wait() sees
+    // this thunk and waits for a worker to drop it, or we see the flag
+    outstanding++;
+    if (discarding) {
+        if (queueCapacity != 0) releaseSlot();
+        abandon(task);
+        dropTasks(1);
+        return;
+    }
+    if (collectStats) {
+        task.setEnqueueTime(stampNow());
+    }
+
+    // Normal thunks spawned by one of our own workers stay local; everything
+    // else goes through the shared lane for its priority
+    bool wasEmpty;
+    int node;
+    if (currentPool == this && priority == Priority::Normal) {
+        node = wts[currentWorker].node;
+        wasEmpty = wts[currentWorker].tasks.push(move(task));
+    } else {
+        node = callerNode();
+        wasEmpty = pushShared(task, node, (size_t)priority);
+    }
+
+    // Only an empty-to-non-empty transition needs a wakeup: whoever takes a
+    // task from a queue that still has more in it wakes the next worker.
+    // The fence pairs with the one in worker(): either we see the parked
+    // worker, or it sees the task we just pushed
+    atomic_thread_fence(memory_order_seq_cst);
+    if (wasEmpty && idleWorkers > 0) {
+        wakeIdleWorker(node);
+    }
+    if (elastic() && idleWorkers == 0 && queuedEstimate() >= (long)growQueueDepth) {
+        growIfNeeded();
+    }
+}
+
+bool ThreadPool::admit(Thunk& task) {
+    // Returns true once the task holds a queue slot, false if it was run
+    // on the calling thread instead
+    while (!reserveSlot()) {
+        if (overflowPolicy == OverflowPolicy::DropOldest) {
+            // The evicted thunk's slot passes straight to this one; if the
+            // queued thunks are all still on their way into a queue, go
+            // over the bound for now rather than wait for them
+            if (!evictOldest()) queued++;
+            return true;
+        }
+        if (overflowPolicy == OverflowPolicy::CallerRuns || currentPool == this || discarding) {
+            outstanding++;
+            execute(task);
+            return false;
+        }
+        unique_lock<mutex> ul(spaceLock);
+        blockedProducers++;
+        spaceFree.wait(ul, [this] { return queued < queueCapacity || discarding; });
+        blockedProducers--;
     }
-    
-    // Notify dispatcher that a new task is available
-    taskAvailable.notify_one();
+    return true;
+}
+
+bool ThreadPool::reserveSlot() {
+    size_t current = queued.load();
+    while (current < queueCapacity) {
+        if (queued.compare_exchange_weak(current, current + 1)) return true;
+    }
+    return false;
+}
+
+void ThreadPool::releaseSlot() {
+    // Pairs with the increment of blockedProducers in admit(): either the
+    // producer sees the freed slot, or we see it waiting
+    queued--;
+    if (blockedProducers > 0) {
+        lock_guard<mutex> lg(spaceLock);
+        spaceFree.notify_one();
+    }
+}
+
+bool ThreadPool::evictOldest() {
+    // From the lowest priority up; normal work lives both in the shared
+    // lanes and in the workers' deques.  popShared and steal both take the
+    // oldest thunk in a queue
+    Thunk victim;
+    bool found = false;
+    for (size_t p = kNumPriorities; p-- > 0 && !found;) {
+        for (int node = 0; node < numNodes && !found; node++) {
+            found = popShared(victim, node, p);
+        }
+        if (p != (size_t)Priority::Normal) continue;
+        for (size_t i = 0; i < wts.size() && !found; i++) {
+            found = wts[i].tasks.steal(victim);
+        }
+    }
+    if (!found) return false;
+
+    abandon(victim);
+    dropped++;
+    if (--outstanding == 0) {
+        lock_guard<mutex> lg(waitLock);
+        allTasksDone.notify_all();
+    }
+    return true;
+}
+
+WorkDeque<Thunk>& ThreadPool::bulkQueue(Priority priority, int& node) {
+    // Same placement as enqueue, except that a batch always goes to the
+    // locked deque of a shared lane, even when the lane has a ring in front
+    if (currentPool == this && priority == Priority::Normal) {
+        node = wts[currentWorker].node;
+        return wts[currentWorker].tasks;
+    }
+    node = callerNode();
+    return lane(node, (size_t)priority).queue;
+}
+
+void ThreadPool::finishBulk(size_t n, int node) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (idleWorkers > 0) {
+        wakeIdleWorkers(n, node);
+    }
+    if (elastic() && idleWorkers == 0 && queuedEstimate() >= (long)growQueueDepth) {
+        growIfNeeded();
+    }
+}
+
+bool ThreadPool::isWorkerThread() const {
+    return currentPool == this;
+}
+
+size_t ThreadPool::size() const {
+    return liveWorkers;
 }
 
 void ThreadPool::wait() {
     unique_lock<mutex> ul(waitLock);
-    allTasksDone.wait(ul, [this] { 
-        lock_guard<mutex> lg(queueLock);
-        return taskQueue.empty() && activeTasks == 0; 
-    });
+    allTasksDone.wait(ul, [this] { return outstanding == 0; });
+}
+
+bool ThreadPool::tryWaitFor(chrono::milliseconds timeout) {
+    unique_lock<mutex> ul(waitLock);
+    return allTasksDone.wait_for(ul, timeout, [this] { return outstanding == 0; });
+}
+
+size_t ThreadPool::shutdownNow() {
+    if (currentPool == this) {
+        throw logic_error("ThreadPool: shutdownNow called from one of the pool's workers");
+    }
+
+    // From here on every thunk that is found, by a worker or by us, is
+    // dropped instead of run.  Empty the queues from this thread too, so
+    // the work doesn't have to wait for busy workers to get to it
+    discarding = true;
+    {
+        lock_guard<mutex> lg(spaceLock);
+        spaceFree.notify_all();
+    }
+    stopTimers();
+    Thunk task;
+    while (findTask(-1, task)) {
+        execute(task);
+    }
+    wait();
+    teardown();
+    return discarded.exchange(0);
 }
 
 ThreadPool::~ThreadPool() {
-    // Signal that we're shutting down
+    // Stop timers first so nothing new comes due, then drain everything
+    // that was scheduled before tearing down
+    stopTimers();
+    wait();
+    teardown();
+}
+
+void ThreadPool::reportError(exception_ptr error) {
+    try {
+        if (errorHandler) {
+            errorHandler(error);
+            return;
+        }
+        try {
+            rethrow_exception(error);
+        } catch (const exception& e) {
+            cerr << "ThreadPool: thunk threw: " << e.what() << endl;
+        } catch (...) {
+            cerr << "ThreadPool: thunk threw a non-standard exception" << endl;
+        }
+    } catch (...) {
+        // A failing handler must not take the worker down either
+    }
+}
+
+void ThreadPool::abandon(Thunk& task) {
+    // Lets whoever waits on the thunk know it will never run
+    try {
+        task.abandon();
+    } catch (...) {
+        reportError(current_exception());
+    }
+}
+
+void ThreadPool::dropTasks(size_t n) {
+    discarded += n;
+    if ((outstanding -= n) == 0) {
+        lock_guard<mutex> lg(waitLock);
+        allTasksDone.notify_all();
+    }
+}
+
+void ThreadPool::teardown() {
     {
-        lock_guard<mutex> lg(queueLock);
+        lock_guard<mutex> lg(growLock);
         done = true;
     }
-    
-    // Notify dispatcher to wake up and exit
-    taskAvailable.notify_all();
-    
-    // Wait for dispatcher to finish
-    if (dt.joinable()) {
-        dt.join();
+
+    // Stop the supervisor first so no worker is spawned from here on
+    supervisorWake.notify_all();
+    if (st.joinable()) {
+        st.join();
     }
-    
-    // Signal all workers to wake up and exit
+
+    // Wake all workers so they can observe the done flag and exit
     for (size_t i = 0; i < wts.size(); i++) {
         wts[i].workReady.signal();
     }
-    
+
     // Wait for all workers to finish
     for (size_t i = 0; i < wts.size(); i++) {
         if (wts[i].ts.joinable()) {
@@ -68,89 +345,497 @@ ThreadPool::~ThreadPool() {
     }
 }
 
-void ThreadPool::dispatcher() {
-    while (true) {
-        // Wait for a task to be available
-        unique_lock<mutex> taskLock(queueLock);
-        taskAvailable.wait(taskLock, [this] { return !taskQueue.empty() || done; });
-        
-        // Check if we should exit
-        if (done && taskQueue.empty()) {
-            taskLock.unlock();
-            break;
+void ThreadPool::wakeIdleWorker(int node) {
+    int workerId;
+    {
+        lock_guard<mutex> lg(workerLock);
+        if (availableWorkers.empty()) return;
+
+        // Prefer the most recently parked worker on the requested node
+        size_t pos = availableWorkers.size() - 1;
+        if (node != -1) {
+            for (size_t i = availableWorkers.size(); i-- > 0;) {
+                if (wts[availableWorkers[i]].node == node) {
+                    pos = i;
+                    break;
+                }
+            }
         }
-        
-        // If no tasks available, continue
-        if (taskQueue.empty()) {
-            taskLock.unlock();
+        workerId = availableWorkers[pos];
+        availableWorkers.erase(availableWorkers.begin() + pos);
+        idleWorkers--;
+        wts[workerId].available = false;
+    }
+    wts[workerId].workReady.signal();
+}
+
+ThreadPool::lane_t& ThreadPool::lane(int node, size_t priority) {
+    return lanes[node * kNumPriorities + priority];
+}
+
+int ThreadPool::callerNode() {
+    if (numNodes == 1) return 0;
+    if (currentPool == this) return wts[currentWorker].node;
+    int cpu = sched_getcpu();
+    int node = cpu >= 0 && cpu < (int)cpuToNode.size() ? cpuToNode[cpu] : 0;
+    return homeNode[node];
+}
+
+bool ThreadPool::pushShared(Thunk& task, int node, size_t priority) {
+    // Once the ring has overflowed, keep appending to the deque until it
+    // drains so that spilled thunks are not overtaken indefinitely
+    lane_t& l = lane(node, priority);
+    bool wasEmpty;
+    if (l.ring && l.queue.empty() && l.ring->push(task, wasEmpty)) {
+        return wasEmpty;
+    }
+    return l.queue.push(move(task));
+}
+
+bool ThreadPool::popShared(Thunk& task, int node, size_t priority) {
+    lane_t& l = lane(node, priority);
+    if (l.ring && l.ring->pop(task)) return true;
+    return l.queue.steal(task);
+}
+
+bool ThreadPool::sharedEmpty() {
+    for (size_t i = 0; i < lanes.size(); i++) {
+        if ((lanes[i].ring && !lanes[i].ring->empty()) || !lanes[i].queue.empty()) return false;
+    }
+    return true;
+}
+
+bool ThreadPool::findTask(int id, Thunk& task) {
+    if (!searchTask(id, task)) return false;
+    if (queueCapacity != 0) releaseSlot();
+    return true;
+}
+
+bool ThreadPool::searchTask(int id, Thunk& task) {
+    // Lanes are served from highest to lowest priority, but every
+    // kAgingInterval searches a worker starts from a rotating lane instead,
+    // which bounds how long a busy higher lane can starve the lower ones
+    size_t first = (size_t)Priority::High;
+    if (id != -1 && ++wts[id].picks % kAgingInterval == 0) {
+        first = (wts[id].picks / kAgingInterval) % kNumPriorities;
+    }
+    int home = id == -1 ? callerNode() : wts[id].node;
+    for (size_t i = 0; i < kNumPriorities; i++) {
+        if (takeFromLane(id, home, (first + i) % kNumPriorities, task)) return true;
+    }
+
+    // Nothing left on our own node: only now cross over to the others
+    for (int n = 1; n < numNodes; n++) {
+        int node = (home + n) % numNodes;
+        for (size_t i = 0; i < kNumPriorities; i++) {
+            if (takeFromLane(id, node, i, task)) return true;
+        }
+    }
+    return false;
+}
+
+bool ThreadPool::takeFromLane(int id, int node, size_t priority, Thunk& task) {
+    // Taking from a queue that still has work left passes the wakeup along
+    // to another parked worker
+    if (priority != (size_t)Priority::Normal) {
+        if (!popShared(task, node, priority)) return false;
+        if (idleWorkers > 0 && !sharedEmpty()) wakeIdleWorker(node);
+        return true;
+    }
+
+    // The normal lane also covers the workers' deques: newest local work
+    // first, then the shared lane, then steal the oldest work from a peer
+    // on the same node.  Threads outside the pool (id == -1) have no local
+    // deque and only steal
+    if (id != -1 && wts[id].node == node && wts[id].tasks.pop(task)) {
+        if (idleWorkers > 0 && !wts[id].tasks.empty()) wakeIdleWorker(node);
+        return true;
+    }
+    if (popShared(task, node, priority)) {
+        if (idleWorkers > 0 && !sharedEmpty()) wakeIdleWorker(node);
+        return true;
+    }
+    size_t start = id == -1 ? 0 : id + 1;
+    for (size_t i = 0; i < wts.size(); i++) {
+        worker_t& victim = wts[(start + i) % wts.size()];
+        if ((int)((start + i) % wts.size()) == id || victim.node != node) continue;
+        if (victim.tasks.steal(task)) {
+            if (id != -1) worker_counters_t::add(wts[id].counters.steals, 1);
+            if (idleWorkers > 0 && !victim.tasks.empty()) wakeIdleWorker(node);
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::wakeIdleWorkers(size_t n, int node) {
+    // Claim and signal up to n parked workers under one lock, preferring
+    // the given node
+    lock_guard<mutex> lg(workerLock);
+    for (int pass = 0; pass < 2 && n > 0; pass++) {
+        for (size_t i = availableWorkers.size(); i-- > 0 && n > 0;) {
+            int id = availableWorkers[i];
+            if (pass == 0 && wts[id].node != node) continue;
+            wts[id].available = false;
+            availableWorkers.erase(availableWorkers.begin() + i);
+            idleWorkers--;
+            wts[id].workReady.signal();
+            n--;
+        }
+    }
+}
+
+bool ThreadPool::elastic() const {
+    return maxThreads > minThreads;
+}
+
+bool ThreadPool::needsSupervisor() const {
+    return elastic() || statsInterval.count() > 0;
+}
+
+int64_t ThreadPool::stampNow() {
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+long ThreadPool::queuedEstimate() {
+    // Everything outstanding that isn't running on a busy worker
+    return (long)outstanding - ((long)liveWorkers - (long)idleWorkers);
+}
+
+size_t ThreadPool::totalExecuted() {
+    size_t total = 0;
+    for (size_t i = 0; i < wts.size(); i++) {
+        total += wts[i].executed.load(memory_order_relaxed);
+    }
+    return total;
+}
+
+void ThreadPool::spawnWorker(size_t id) {
+    wts[id].running = true;
+    liveWorkers++;
+    wts[id].ts = thread([this, id] { worker(id); });
+}
+
+void ThreadPool::growIfNeeded() {
+    lock_guard<mutex> lg(growLock);
+    if (done || liveWorkers >= maxThreads) return;
+    for (size_t i = 0; i < wts.size(); i++) {
+        if (wts[i].running) continue;
+        // The slot may still hold the handle of a worker that retired
+        if (wts[i].ts.joinable()) {
+            wts[i].ts.join();
+        }
+        spawnWorker(i);
+        return;
+    }
+}
+
+int ThreadPool::tryRetire(int id) {
+    lock_guard<mutex> lg(workerLock);
+    vector<int>::iterator it = find(availableWorkers.begin(), availableWorkers.end(), id);
+    if (it == availableWorkers.end()) return kClaimed;
+    if (liveWorkers <= minThreads) return kStay;
+    availableWorkers.erase(it);
+    idleWorkers--;
+    liveWorkers--;
+    return kRetired;
+}
+
+void ThreadPool::supervisor() {
+    // Wakes every growAfter (elastic pools) or statsInterval (dumping
+    // pools), whichever is shorter, and does whichever jobs are due
+    chrono::milliseconds tick = elastic() ? growAfter : statsInterval;
+    if (statsInterval.count() > 0 && statsInterval < tick) tick = statsInterval;
+    chrono::steady_clock::time_point lastGrowCheck = chrono::steady_clock::now();
+    chrono::steady_clock::time_point lastDump = lastGrowCheck;
+
+    size_t lastExecuted = totalExecuted();
+    unique_lock<mutex> ul(growLock);
+    while (!done) {
+        supervisorWake.wait_for(ul, tick);
+        if (done) break;
+        chrono::steady_clock::time_point now = chrono::steady_clock::now();
+
+        // Queued work that has seen no thunk complete for a whole growAfter
+        // period means every worker is stuck (blocked on I/O, or just long
+        // thunks), so add a worker; the enqueue-side check can't see this case
+        if (elastic() && now - lastGrowCheck >= growAfter) {
+            lastGrowCheck = now;
+            size_t executed = totalExecuted();
+            bool stalled = executed == lastExecuted;
+            lastExecuted = executed;
+            if (stalled && idleWorkers == 0 && queuedEstimate() > 0) {
+                ul.unlock();
+                growIfNeeded();
+                ul.lock();
+            }
+        }
+
+        if (statsInterval.count() > 0 && now - lastDump >= statsInterval) {
+            lastDump = now;
+            ul.unlock();
+            *statsStream << stats() << endl;
+            ul.lock();
+        }
+    }
+}
+
+ThreadPoolStats ThreadPool::stats() {
+    ThreadPoolStats snapshot;
+    snapshot.queueDepth = 0;
+    for (size_t i = 0; i < lanes.size(); i++) {
+        snapshot.queueDepth += lanes[i].queue.size();
+        if (lanes[i].ring) snapshot.queueDepth += lanes[i].ring->size();
+    }
+    for (size_t i = 0; i < wts.size(); i++) {
+        snapshot.queueDepth += wts[i].tasks.size();
+    }
+    snapshot.outstanding = outstanding;
+    snapshot.liveWorkers = liveWorkers;
+    snapshot.idleWorkers = idleWorkers;
+    snapshot.executed = 0;
+    snapshot.steals = 0;
+    snapshot.dropped = dropped;
+    snapshot.failed = failures;
+
+    for (size_t i = 0; i < wts.size(); i++) {
+        const worker_counters_t& counters = wts[i].counters;
+        WorkerStats ws;
+        ws.executed = wts[i].executed.load(memory_order_relaxed);
+        ws.steals = counters.steals.load(memory_order_relaxed);
+        ws.busyTime = chrono::nanoseconds(counters.busyNanos.load(memory_order_relaxed));
+        ws.idleTime = chrono::nanoseconds(counters.idleNanos.load(memory_order_relaxed));
+        snapshot.workers.push_back(ws);
+        snapshot.executed += ws.executed;
+        snapshot.steals += ws.steals;
+        for (size_t b = 0; b < kLatencyBuckets; b++) {
+            snapshot.queueWait.buckets[b] += counters.waitBuckets[b].load(memory_order_relaxed);
+            snapshot.runTime.buckets[b] += counters.runBuckets[b].load(memory_order_relaxed);
+        }
+    }
+    return snapshot;
+}
+
+TimerHandle ThreadPool::scheduleAfter(chrono::nanoseconds delay, function<void(void)> thunk, Priority priority) {
+    shared_ptr<scheduled_timer_t> timer = make_shared<scheduled_timer_t>();
+    timer->thunk = move(thunk);
+    timer->due = chrono::steady_clock::now() + delay;
+    timer->priority = priority;
+    armTimer(timer);
+    return TimerHandle(timer);
+}
+
+TimerHandle ThreadPool::scheduleEvery(chrono::nanoseconds period, function<void(void)> thunk, Priority priority) {
+    if (period.count() <= 0) {
+        throw invalid_argument("ThreadPool: scheduleEvery needs a positive period");
+    }
+    shared_ptr<scheduled_timer_t> timer = make_shared<scheduled_timer_t>();
+    timer->thunk = move(thunk);
+    timer->due = chrono::steady_clock::now() + period;
+    timer->period = period;
+    timer->priority = priority;
+    armTimer(timer);
+    return TimerHandle(timer);
+}
+
+void ThreadPool::armTimer(const shared_ptr<scheduled_timer_t>& timer) {
+    lock_guard<mutex> lg(timerLock);
+    if (timerStop) return;
+    if (!tt.joinable()) {
+        tt = thread([this] { timerLoop(); });
+    }
+    bool soonest = timers.empty() || timer->due < timers.top().due;
+    timers.push(timer_entry_t{timer->due, timer});
+    if (soonest) {
+        timerWake.notify_one();
+    }
+}
+
+void ThreadPool::timerLoop() {
+    unique_lock<mutex> ul(timerLock);
+    while (!timerStop) {
+        if (timers.empty()) {
+            timerWake.wait(ul);
             continue;
         }
-        
-        // Get the next task
-        function<void(void)> task = taskQueue.front();
-        taskQueue.pop();
-        taskLock.unlock();
-        
-        // Wait for an available worker
-        unique_lock<mutex> workerLock_ul(workerLock);
-        workerAvailable.wait(workerLock_ul, [this] { return !availableWorkers.empty() || done; });
-        
-        // Check if we should exit
-        if (done) {
-            workerLock_ul.unlock();
-            break;
+        if (timers.top().due > chrono::steady_clock::now()) {
+            timerWake.wait_until(ul, timers.top().due);
+            continue;
         }
-        
-        // Get an available worker
-        int workerId = availableWorkers.front();
-        availableWorkers.pop();
-        workerLock_ul.unlock();
-        
-        // Mark worker as unavailable and assign task
-        wts[workerId].available = false;
-        wts[workerId].thunk = task;
-        
-        // Increment active tasks counter
-        {
-            lock_guard<mutex> lg(waitLock);
-            activeTasks++;
+        shared_ptr<scheduled_timer_t> timer = timers.top().timer;
+        timers.pop();
+        if (timer->cancelled) continue;
+        ul.unlock();
+        fireTimer(timer);
+        ul.lock();
+    }
+}
+
+void ThreadPool::fireTimer(const shared_ptr<scheduled_timer_t>& timer) {
+    // Straight into the queues, past admission: waiting for room, or
+    // running the thunk right here, would hold up every other timer
+    // behind one full queue.  If there is no slot, go over the bound
+    if (queueCapacity != 0 && !reserveSlot()) queued++;
+    push(Thunk(timer_firing_t{this, timer}, &slab), timer->priority);
+}
+
+void ThreadPool::timer_firing_t::operator()() {
+    // The timer only goes back on the heap once this run is over, so runs
+    // of a periodic thunk never overlap
+    // A periodic thunk that throws still fires again; the exception goes
+    // on to the pool's error handler
+    if (timer->cancelled) return;
+    exception_ptr error;
+    try {
+        timer->thunk();
+    } catch (...) {
+        error = current_exception();
+    }
+    rearm();
+    if (error) rethrow_exception(error);
+}
+
+void ThreadPool::timer_firing_t::abandon() {
+    // A firing dropped from the queues only skips this run
+    rearm();
+}
+
+void ThreadPool::timer_firing_t::rearm() {
+    if (timer->period.count() != 0 && !timer->cancelled) {
+        timer->due = max(timer->due + timer->period, chrono::steady_clock::now());
+        pool->armTimer(timer);
+    }
+}
+
+void ThreadPool::stopTimers() {
+    {
+        lock_guard<mutex> lg(timerLock);
+        timerStop = true;
+    }
+    timerWake.notify_all();
+    if (tt.joinable()) {
+        tt.join();
+    }
+}
+
+bool ThreadPool::runPendingTask() {
+    Thunk task;
+    if (!findTask(currentPool == this ? currentWorker : -1, task)) return false;
+    execute(task);
+    return true;
+}
+
+void ThreadPool::execute(Thunk& task, int id) {
+    // Run the task, unless the pool is being shut down, and release
+    // whatever it captured
+    bool run = !discarding;
+    int64_t start = run && id != -1 && collectStats ? stampNow() : 0;
+    if (run) {
+        try {
+            task();
+        } catch (...) {
+            failures++;
+            reportError(current_exception());
+        }
+    } else {
+        abandon(task);
+        discarded++;
+    }
+    task = nullptr;
+
+    // A worker accounts for the task before completing it, so stats() taken
+    // after wait() returns already include it
+    if (run && id != -1) {
+        worker_t& w = wts[id];
+        if (collectStats) {
+            int64_t elapsed = stampNow() - start;
+            worker_counters_t::record(w.counters.runBuckets, elapsed);
+            worker_counters_t::add(w.counters.busyNanos, elapsed);
         }
-        
-        // Signal the worker to start working
-        wts[workerId].workReady.signal();
+        w.executed.store(w.executed.load(memory_order_relaxed) + 1, memory_order_relaxed);
+    }
+
+    // Decrement outstanding tasks counter and notify if all tasks are done
+    if (--outstanding == 0) {
+        lock_guard<mutex> lg(waitLock);
+        allTasksDone.notify_all();
+    }
+}
+
+bool ThreadPool::hasQueuedTasks() {
+    if (!sharedEmpty()) return true;
+    for (size_t i = 0; i < wts.size(); i++) {
+        if (!wts[i].tasks.empty()) return true;
     }
+    return false;
 }
 
 void ThreadPool::worker(int id) {
+    currentPool = this;
+    currentWorker = id;
+    if (!wts[id].cpus.empty() && !pinThread(pthread_self(), wts[id].cpus)) {
+        // Run unpinned rather than not at all, but don't hide it
+        reportError(make_exception_ptr(runtime_error("ThreadPool: could not pin worker " + to_string(id) +
+                                                     " to its CPUs")));
+    }
+
+    // With collectStats, everything between the end of one thunk and the
+    // start of the next (searching and parking) counts as idle time
+    worker_counters_t& counters = wts[id].counters;
+    int64_t lastFinish = collectStats ? stampNow() : 0;
+    Thunk task;
     while (true) {
-        // Wait for work to be assigned
-        wts[id].workReady.wait();
-        
-        // Check if we should exit
-        if (done) {
-            break;
+        if (findTask(id, task)) {
+            wts[id].thunk = move(task);
+            if (collectStats) {
+                int64_t start = stampNow();
+                int64_t queuedAt = wts[id].thunk.enqueueTime();
+                if (queuedAt != 0) {
+                    worker_counters_t::record(counters.waitBuckets, start > queuedAt ? start - queuedAt : 0);
+                }
+                worker_counters_t::add(counters.idleNanos, start - lastFinish);
+            }
+            execute(wts[id].thunk, id);
+            if (collectStats) {
+                lastFinish = stampNow();
+            }
+            continue;
         }
-        
-        // Execute the assigned task
-        wts[id].thunk();
-        
-        // Mark worker as available again
+
+        // No work: register as available and park until someone signals us
         {
             lock_guard<mutex> lg(workerLock);
             wts[id].available = true;
-            availableWorkers.push(id);
+            availableWorkers.push_back(id);
+            idleWorkers++;
         }
-        
-        // Decrement active tasks counter and notify if all tasks are done
-        {
-            lock_guard<mutex> lg(waitLock);
-            activeTasks--;
-            if (activeTasks == 0) {
-                allTasksDone.notify_all();
+
+        // Work may have been queued between our search and the registration
+        // above; if so make sure some parked worker (possibly us) picks it up
+        atomic_thread_fence(memory_order_seq_cst);
+        if (hasQueuedTasks()) {
+            wakeIdleWorker();
+        }
+
+        // Elastic pools let extra workers that idle for too long retire
+        while (true) {
+            if (!elastic()) {
+                wts[id].workReady.wait();
+                break;
+            }
+            if (wts[id].workReady.waitFor(idleTimeout)) break;
+            int outcome = tryRetire(id);
+            if (outcome == kRetired) {
+                wts[id].running = false;
+                return;
+            }
+            if (outcome == kClaimed) {
+                wts[id].workReady.wait();
+                break;
             }
         }
-        
-        // Notify dispatcher that this worker is available
-        workerAvailable.notify_one();
+        if (done) {
+            break;
+        }
     }
-}
\ No newline at end of file
+}
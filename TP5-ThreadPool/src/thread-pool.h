@@ -11,13 +11,26 @@
 #define _thread_pool_
 
 #include <cstddef>     // for size_t
-#include <functional>  // for the function template used in the schedule signature
+#include <functional>  // for bind, function
+#include <initializer_list> // for initializer_list
 #include <thread>      // for thread
 #include <vector>      // for vector
-#include <queue>       // for queue
 #include <mutex>       // for mutex
 #include <condition_variable> // for condition_variable
-#include "Semaphore.h" // for Semaphore
+#include <atomic>      // for atomic
+#include <memory>      // for unique_ptr, shared_ptr
+#include <future>      // for future, packaged_task
+#include <type_traits> // for result_of
+#include <stdexcept>   // for invalid_argument, runtime_error, logic_error
+#include <exception>   // for exception_ptr
+#include <chrono>      // for milliseconds, steady_clock
+#include <queue>       // for priority_queue
+#include <iostream>    // for ostream, cerr
+#include "Semaphore.h" // for SpinSemaphore
+#include "work-deque.h" // for WorkDeque
+#include "mpmc-ring.h" // for MpmcRing
+#include "thunk.h"     // for Thunk, ThunkSlab
+#include "pool-stats.h" // for ThreadPoolStats, worker_counters_t
 
 using namespace std;
 
@@ -26,19 +39,181 @@ using namespace std;
  * 
  * The `worker_t` struct contains information about a worker 
  * thread in the thread pool. Includes the thread object, 
- * availability status, the task to be executed, and a semaphore 
- * to signal when work is ready for the worker to process.
+ * availability status, the task to be executed, the worker's own
+ * deque of pending tasks, its statistics counters, and a semaphore to
+ * signal when work is ready for the worker to process.
  */
 typedef struct worker {
     thread ts;                          // thread handle
-    function<void(void)> thunk;         // task to execute
+    Thunk thunk;                        // task to execute
+    WorkDeque<Thunk> tasks;             // local tasks, stolen by peers when idle
+    size_t picks;                       // task searches so far, drives starvation protection
+    int node;                           // NUMA node whose queues this worker serves first
+    vector<int> cpus;                   // CPUs the worker is pinned to, empty if unpinned
+    atomic<bool> running;               // a thread currently occupies this slot
+    atomic<size_t> executed;            // thunks run so far, written only by the worker
+    worker_counters_t counters;         // steals, timings and latencies, written only by the worker
     bool available;                     // worker availability status
-    Semaphore workReady;                // semaphore to signal work is ready
-    Semaphore workDone;                 // semaphore to signal work is completed
+    SpinSemaphore workReady;            // semaphore to signal work is ready
+    SpinSemaphore workDone;             // semaphore to signal work is completed
     
-    worker() : available(true), workReady(0), workDone(0) {}
+    worker() : picks(0), node(0), running(false), executed(0), available(true), workReady(0), workDone(0) {}
 } worker_t;
 
+/**
+ * @brief Selects how the pool's shared task queue is implemented.
+ *
+ * `Locked` is a mutex-protected deque.  `LockFree` puts a bounded
+ * lock-free ring in front of it, so concurrent producers never serialize
+ * on a lock; thunks only spill into the locked deque while the ring is full.
+ */
+enum class QueueBackend { Locked, LockFree };
+
+/**
+ * @brief Priority lane a thunk is scheduled into.
+ *
+ * Workers drain `High` before `Normal` and `Normal` before `Low`, except
+ * that every few picks they start from a rotating lane instead, so a
+ * steady stream of urgent work cannot starve the lower lanes.
+ */
+enum class Priority { High, Normal, Low };
+
+/**
+ * @brief What schedule() does when a bounded pool's queues are full.
+ *
+ * `Block` makes the producer wait for room; `CallerRuns` runs the thunk on
+ * the producer's thread instead of queueing it; `DropOldest` destroys the
+ * oldest queued thunk, lowest priority first, to make room.  An evicted
+ * thunk is abandoned rather than silently lost (see Thunk::abandon): a
+ * TaskGroup waiting on it throws, a coroutine resumes with its co_await
+ * throwing, and a periodic timer skips one run.  trySchedule() ignores the
+ * policy and just returns false.
+ */
+enum class OverflowPolicy { Block, CallerRuns, DropOldest };
+
+/**
+ * @brief Construction-time settings for a ThreadPool.
+ *
+ * By default workers float freely across all CPUs.  Setting `cpus` pins
+ * worker i to cpus[i % cpus.size()]; setting `numaNode` pins every worker
+ * to that node's CPUs; setting `spreadAcrossNodes` pins workers round-robin
+ * to each node's CPUs.  Whenever workers are pinned, the shared queues are
+ * kept per NUMA node: thunks land on the scheduling thread's node, workers
+ * serve their own node first and only cross to another node when idle.
+ *
+ * Setting `maxThreads` above `numThreads` makes the pool elastic: it starts
+ * with `numThreads` workers and adds one whenever `growQueueDepth` thunks
+ * are queued with no idle worker, or whenever queued work has seen no
+ * thunk complete for `growAfter` (every worker is blocked, e.g. on I/O).
+ * Workers beyond `numThreads` that stay idle for `idleTimeout` retire.
+ *
+ * Setting `collectStats` timestamps every thunk so stats() can report
+ * queue-wait and run-time histograms and per-worker busy/idle time; it
+ * costs two clock reads per thunk and is off by default.  Setting
+ * `statsInterval` also prints a stats() line to `statsStream` that often.
+ *
+ * Setting `queueCapacity` bounds how many thunks may be queued and not yet
+ * started; `overflowPolicy` says what schedule() does once the bound is
+ * reached.  A worker scheduling into a full pool is never blocked, since
+ * that could deadlock the pool: it runs the thunk itself instead.  Timers
+ * that come due are always queued, over the bound if need be, so that one
+ * full queue never holds up the timer thread.
+ *
+ * A thunk that throws doesn't take its worker down: the exception is
+ * passed to `errorHandler` on the worker's thread, or printed to cerr if
+ * none is set, and the worker moves on to the next thunk.  A worker the
+ * kernel won't pin to its CPUs reports a runtime_error the same way and
+ * runs unpinned.
+ */
+struct ThreadPoolOptions {
+    size_t numThreads;                  // number of worker threads, the minimum if elastic
+    QueueBackend backend;               // implementation of the shared queues
+    vector<int> cpus;                   // CPUs to pin workers to, one per worker, reused cyclically
+    int numaNode;                       // NUMA node to confine every worker to, or -1
+    bool spreadAcrossNodes;             // pin workers round-robin across all NUMA nodes
+    size_t maxThreads;                  // upper bound on workers, or 0 for a fixed-size pool
+    size_t growQueueDepth;              // queued thunks, with no idle worker, that add a worker
+    chrono::milliseconds growAfter;     // time without progress on queued work that adds a worker
+    chrono::milliseconds idleTimeout;   // idle time after which an extra worker retires
+    bool collectStats;                  // record per-thunk timings for stats()
+    chrono::milliseconds statsInterval; // period of the stats dump, or 0 for none
+    ostream *statsStream;               // where the stats dump goes
+    size_t queueCapacity;               // most thunks queued at once, or 0 for no bound
+    OverflowPolicy overflowPolicy;      // what schedule() does when the queues are full
+    function<void(exception_ptr)> errorHandler; // called with exceptions thunks throw, if set
+
+    ThreadPoolOptions(size_t numThreads = thread::hardware_concurrency())
+        : numThreads(numThreads), backend(QueueBackend::Locked), numaNode(-1), spreadAcrossNodes(false),
+          maxThreads(0), growQueueDepth(4), growAfter(50), idleTimeout(5000), collectStats(false),
+          statsInterval(0), statsStream(&cerr), queueCapacity(0), overflowPolicy(OverflowPolicy::Block) {}
+};
+
+/**
+ * @brief A thunk waiting on the pool's timer thread, from scheduleAfter or
+ * scheduleEvery.  Shared between the timer heap, the queued firing and
+ * the caller's TimerHandle.
+ */
+typedef struct scheduled_timer {
+    function<void(void)> thunk;         // what to run when the timer fires
+    chrono::steady_clock::time_point due; // next firing time
+    chrono::nanoseconds period;         // time between firings, zero for one-shot timers
+    Priority priority;                  // lane the thunk is queued into when due
+    atomic<bool> cancelled;             // set by TimerHandle::cancel
+
+    scheduled_timer() : period(0), priority(Priority::Normal), cancelled(false) {}
+} scheduled_timer_t;
+
+/**
+ * @brief Lets the caller cancel a delayed or periodic thunk.
+ *
+ * Cancelling stops every firing that hasn't started yet; a run already in
+ * progress finishes.  Handles are cheap to copy and may outlive the pool.
+ */
+class TimerHandle {
+  public:
+    TimerHandle() {}
+    explicit TimerHandle(const shared_ptr<scheduled_timer_t>& timer) : timer(timer) {}
+
+  /**
+  * Cancels the timer.  Does nothing if it was already cancelled, or is a
+  * one-shot timer that has already run.
+  */
+    void cancel() { if (timer) timer->cancelled = true; }
+
+  /**
+  * Returns true if cancel() has been called on this timer.
+  */
+    bool cancelled() const { return timer && timer->cancelled; }
+
+  private:
+    shared_ptr<scheduled_timer_t> timer;
+};
+
+/**
+ * @brief A flag shared by everyone holding a copy, used to cancel thunks.
+ *
+ * Thunks scheduled with a token are skipped if it is cancelled before they
+ * start; a long-running thunk can also poll cancelled() and return early.
+ * Copies share one flag, and it stays cancelled once set.
+ */
+class CancellationToken {
+  public:
+    CancellationToken() : flag(make_shared<atomic<bool>>(false)) {}
+
+  /**
+  * Cancels every thunk holding this token that hasn't started yet.
+  */
+    void cancel() { *flag = true; }
+
+  /**
+  * Returns true once cancel() has been called on any copy.
+  */
+    bool cancelled() const { return *flag; }
+
+  private:
+    shared_ptr<atomic<bool>> flag;
+};
+
 class ThreadPool {
   public:
 
@@ -48,13 +223,209 @@ class ThreadPool {
   */
     ThreadPool(size_t numThreads);
 
+  /**
+  * Constructs a ThreadPool like the one above, using the given
+  * backend for the shared task queue.
+  */
+    ThreadPool(size_t numThreads, QueueBackend backend);
+
+  /**
+  * Constructs a ThreadPool from the given options.  Throws
+  * invalid_argument if they name a CPU or NUMA node that doesn't exist.
+  */
+    ThreadPool(const ThreadPoolOptions& options);
+
   /**
   * Schedules the provided thunk (which is something that can
   * be invoked as a zero-argument function without a return value)
   * to be executed by one of the ThreadPool's threads as soon as
-  * all previously scheduled thunks have been handled.
+  * all previously scheduled thunks have been handled.  Thunks scheduled
+  * from inside a running thunk go to the calling worker's own deque,
+  * where idle peers can steal them.  High and low priority thunks always
+  * go to the pool-wide lane for their priority.
+  *
+  * The thunk is moved into a Thunk, so small captures are stored inline
+  * and scheduling does not allocate in steady state.
+  */
+    template <typename F>
+    void schedule(F&& thunk, Priority priority = Priority::Normal) {
+        enqueue(Thunk(forward<F>(thunk), &slab), priority);
+    }
+
+  /**
+  * Schedules the thunk like schedule does, unless the pool is bounded and
+  * its queues are full, in which case the thunk is not scheduled and
+  * false is returned.  Never blocks.
+  */
+    template <typename F>
+    bool trySchedule(F&& thunk, Priority priority = Priority::Normal) {
+        if (queueCapacity != 0 && !reserveSlot()) return false;
+        push(Thunk(forward<F>(thunk), &slab), priority);
+        return true;
+    }
+
+  /**
+  * Schedules the thunk like the overload above, but skips it if the token
+  * has been cancelled by the time a worker picks it up.
+  */
+    template <typename F>
+    void schedule(F&& thunk, const CancellationToken& token, Priority priority = Priority::Normal) {
+        enqueue(Thunk(cancellable_thunk_t<typename decay<F>::type>(forward<F>(thunk), token), &slab), priority);
+    }
+
+  /**
+  * Schedules every thunk in [first, last) as one batch: they are queued
+  * with a single lock acquisition, and up to one idle worker per thunk is
+  * woken at once.  Each element is copied into a Thunk; pass move
+  * iterators to move them instead.  A bounded pool admits the thunks one
+  * at a time, as if each were passed to schedule.  If copying an element
+  * throws, the thunks before it stay scheduled and the exception
+  * propagates.
+  */
+    template <typename It>
+    void scheduleBulk(It first, It last, Priority priority = Priority::Normal) {
+        if (queueCapacity != 0) {
+            for (It it = first; it != last; ++it) schedule(*it, priority);
+            return;
+        }
+        size_t n = 0;
+        for (It it = first; it != last; ++it) n++;
+        if (n == 0) return;
+        outstanding += n;
+        if (discarding) {
+            dropTasks(n);
+            return;
+        }
+        int node;
+        WorkDeque<Thunk>& queue = bulkQueue(priority, node);
+        int64_t now = collectStats ? stampNow() : 0;
+        size_t pushed = 0;
+        try {
+            queue.pushAll(n, [this, &first, &pushed, now] {
+                Thunk task(*first++, &slab);
+                task.setEnqueueTime(now);
+                pushed++;
+                return task;
+            });
+        } catch (...) {
+            // Take back the count of the thunks that never made it in
+            if ((outstanding -= n - pushed) == 0) {
+                lock_guard<mutex> lg(waitLock);
+                allTasksDone.notify_all();
+            }
+            if (pushed != 0) finishBulk(pushed, node);
+            throw;
+        }
+        finishBulk(n, node);
+    }
+
+  /**
+  * Schedules a braced list of thunks as one batch, like scheduleBulk.
+  */
+    void schedule(initializer_list<function<void(void)>> thunks, Priority priority = Priority::Normal) {
+        scheduleBulk(thunks.begin(), thunks.end(), priority);
+    }
+
+  /**
+  * Schedules the thunk to be queued once the delay has passed, like
+  * schedule does at that point.  Waiting happens on a single timer thread
+  * the pool starts on first use, not on a worker.  wait() only covers
+  * timers that have already come due; timers still pending when the pool
+  * is destroyed never run.
+  */
+    TimerHandle scheduleAfter(chrono::nanoseconds delay, function<void(void)> thunk,
+                              Priority priority = Priority::Normal);
+
+  /**
+  * Schedules the thunk to run every period, first one period from now,
+  * until cancelled through the returned handle or the pool is destroyed.
+  * Runs never overlap: the next firing is armed once the current run ends,
+  * one period after the previous due time, or straight away if that time
+  * has already passed.
+  * Throws invalid_argument if period is not positive.
+  */
+    TimerHandle scheduleEvery(chrono::nanoseconds period, function<void(void)> thunk,
+                              Priority priority = Priority::Normal);
+
+  /**
+  * Awaitable returned by schedule() with no arguments: `co_await
+  * pool.schedule()` suspends the calling coroutine and resumes it on one of
+  * the pool's workers.  Needs C++20 to be awaited, but is plain C++11
+  * otherwise, so it costs nothing to pre-C++20 users of this header.  See
+  * coro-task.h.
+  */
+    class ScheduleAwaiter {
+      public:
+        explicit ScheduleAwaiter(ThreadPool& pool) : pool(pool), dropped(false) {}
+        bool await_ready() const { return false; }
+        template <typename Handle>
+        void await_suspend(Handle handle) { pool.schedule(resume_thunk_t<Handle>{handle, &dropped}); }
+        void await_resume() const {
+            if (dropped) throw runtime_error("ThreadPool: shut down before the coroutine could resume on it");
+        }
+      private:
+        // If the pool drops the resumption, the coroutine is resumed anyway
+        // on the dropping thread, and its co_await throws instead of hanging
+        template <typename Handle>
+        struct resume_thunk_t {
+            Handle handle;
+            bool *dropped;
+            void operator()() { handle.resume(); }
+            void abandon() {
+                *dropped = true;
+                handle.resume();
+            }
+        };
+
+        ThreadPool& pool;
+        bool dropped;
+    };
+
+  /**
+  * Returns an awaitable that moves the awaiting coroutine onto the pool.
+  */
+    ScheduleAwaiter schedule() { return ScheduleAwaiter(*this); }
+
+  /**
+  * Schedules f(args...) like schedule does, and returns a future for its
+  * result.  If f throws, the exception is stored in the future and
+  * rethrown by get(), rather than escaping into the worker.  Waiting on the
+  * future only waits for this call, not for everything else in the pool.
+  */
+    template <typename F, typename... Args>
+    auto submit(F&& f, Args&&... args) -> future<typename result_of<F(Args...)>::type> {
+        typedef typename result_of<F(Args...)>::type result_t;
+        shared_ptr<packaged_task<result_t()>> task =
+            make_shared<packaged_task<result_t()>>(bind(forward<F>(f), forward<Args>(args)...));
+        future<result_t> result = task->get_future();
+        schedule([task] { (*task)(); });
+        return result;
+    }
+
+  /**
+  * Runs one queued thunk on the calling thread, if there is one, and
+  * returns whether it did.  Lets a thread that is waiting on part of the
+  * pool's work help with it instead of blocking a worker.
   */
-    void schedule(const function<void(void)>& thunk);
+    bool runPendingTask();
+
+  /**
+  * Returns true if the calling thread is one of this pool's workers.
+  */
+    bool isWorkerThread() const;
+
+  /**
+  * Returns the number of worker threads currently in the pool.
+  */
+    size_t size() const;
+
+  /**
+  * Returns a snapshot of the pool's queue depth, worker counts and
+  * counters.  Safe to call from any thread at any time; the figures are
+  * read without stopping the workers, so they may be slightly out of step
+  * with each other.
+  */
+    ThreadPoolStats stats();
 
   /**
   * Blocks and waits until all previously scheduled thunks
@@ -62,6 +433,30 @@ class ThreadPool {
   */
     void wait();
 
+  /**
+  * Like wait(), but gives up after the timeout.  Returns true if every
+  * scheduled thunk had finished, false if the time ran out first.
+  */
+    bool tryWaitFor(chrono::milliseconds timeout);
+
+  /**
+  * Shuts the pool down without running the work still queued: pending
+  * timers are dropped, queued thunks are destroyed unrun, and thunks
+  * scheduled from here on are discarded as well.  Thunks already running
+  * are waited for.  Returns the number of thunks discarded.  The pool
+  * cannot be used afterwards, except to be destroyed.
+  *
+  * Whoever waits on a discarded thunk is released rather than left
+  * hanging: TaskGroup::wait (and so parallel_for, parallel_reduce and
+  * TaskGraph::run) throws a runtime_error, a future from submit() reports
+  * a broken promise, and a coroutine awaiting schedule() resumes on the
+  * discarding thread with its co_await throwing.
+  *
+  * Throws logic_error if called from one of the pool's own workers, which
+  * could never finish waiting for itself.
+  */
+    size_t shutdownNow();
+
   /**
   * Waits for all previously scheduled thunks to execute, and then
   * properly brings down the ThreadPool and any resources tapped
@@ -71,25 +466,141 @@ class ThreadPool {
     
   private:
 
+    static const size_t kNumPriorities = 3;
+
+    template <typename Fn>
+    struct cancellable_thunk_t {
+        Fn fn;
+        CancellationToken token;
+
+        template <typename F>
+        cancellable_thunk_t(F&& fn, const CancellationToken& token) : fn(forward<F>(fn)), token(token) {}
+
+        void operator()() {
+            if (!token.cancelled()) fn();
+        }
+    };
+
+    /**
+    * One firing of a timer, as queued by the timer thread.
+    */
+    struct timer_firing_t {
+        ThreadPool *pool;
+        shared_ptr<scheduled_timer_t> timer;
+
+        void operator()();
+        void abandon();
+        void rearm();
+    };
+
+    /**
+    * A pool-wide queue for one priority: a locked deque, optionally
+    * fronted by a lock-free ring.
+    */
+    struct lane_t {
+        WorkDeque<Thunk> queue;             // locked queue, also the ring's overflow
+        unique_ptr<MpmcRing<Thunk>> ring;   // lock-free front of queue, if selected
+    };
+
     void worker(int id);
-    void dispatcher();
+    void supervisor();
+    void timerLoop();
+    void armTimer(const shared_ptr<scheduled_timer_t>& timer);
+    void fireTimer(const shared_ptr<scheduled_timer_t>& timer);
+    void stopTimers();
+    void teardown();
+    void dropTasks(size_t n);
+    void abandon(Thunk& task);
+    void reportError(exception_ptr error);
+    bool needsSupervisor() const;
+    static int64_t stampNow();
+    void enqueue(Thunk&& task, Priority priority);
+    void push(Thunk&& task, Priority priority);
+    bool admit(Thunk& task);
+    bool reserveSlot();
+    void releaseSlot();
+    bool evictOldest();
+    void execute(Thunk& task, int id = -1);
+    WorkDeque<Thunk>& bulkQueue(Priority priority, int& node);
+    void finishBulk(size_t n, int node);
+    bool findTask(int id, Thunk& task);
+    bool searchTask(int id, Thunk& task);
+    bool takeFromLane(int id, int node, size_t priority, Thunk& task);
+    bool pushShared(Thunk& task, int node, size_t priority);
+    bool popShared(Thunk& task, int node, size_t priority);
+    lane_t& lane(int node, size_t priority);
+    int callerNode();
+    bool sharedEmpty();
+    bool hasQueuedTasks();
+    void wakeIdleWorker(int node = -1);
+    void wakeIdleWorkers(size_t n, int node);
+    bool elastic() const;
+    long queuedEstimate();
+    size_t totalExecuted();
+    void spawnWorker(size_t id);
+    void growIfNeeded();
+    int tryRetire(int id);
     
-    thread dt;                              // dispatcher thread handle
+    ThunkSlab slab;                         // blocks for thunks too large to store inline; outlives every queue
     vector<worker_t> wts;                   // worker thread handles
-    bool done;                              // flag to indicate the pool is being destroyed
+    atomic<bool> done;                      // flag to indicate the pool is being destroyed
     
-    // Task queue management
-    queue<function<void(void)>> taskQueue;  // queue of tasks to execute
-    mutex queueLock;                        // mutex to protect the queue of tasks
-    condition_variable taskAvailable;       // notify dispatcher when tasks are available
+    // Task queue management; workers pull from it directly, there is no dispatcher
+    vector<lane_t> lanes;                   // shared queues, kNumPriorities per NUMA node
+    int numNodes;                           // NUMA nodes the queues are split across, 1 if unpinned
+    vector<int> homeNode;                   // node whose queues a producer on each node feeds
+    vector<int> cpuToNode;                  // NUMA node of every CPU, used to find the producer's node
     
     // Worker availability management
-    queue<int> availableWorkers;            // queue of available worker IDs
+    vector<int> availableWorkers;           // stack of IDs of workers parked on their workReady semaphore
+    atomic<size_t> idleWorkers;             // size of availableWorkers, readable without the lock
     mutex workerLock;                       // mutex to protect worker availability
-    condition_variable workerAvailable;     // notify dispatcher when workers are available
+    
+    // Elastic sizing; wts holds maxThreads slots, of which liveWorkers are running
+    size_t minThreads;                      // workers that never retire
+    size_t maxThreads;                      // slots in wts
+    size_t growQueueDepth;                  // see ThreadPoolOptions
+    chrono::milliseconds growAfter;         // see ThreadPoolOptions
+    chrono::milliseconds idleTimeout;       // see ThreadPoolOptions
+    atomic<size_t> liveWorkers;             // slots with a running thread
+    mutex growLock;                         // serializes spawning, protects the slots' thread handles
+    condition_variable supervisorWake;      // wakes the supervisor early at shutdown
+    thread st;                              // supervisor thread handle, elastic or dumping pools only
+    
+    // Instrumentation
+    bool collectStats;                      // see ThreadPoolOptions
+    chrono::milliseconds statsInterval;     // see ThreadPoolOptions
+    ostream *statsStream;                   // see ThreadPoolOptions
+    
+    // Delayed and periodic thunks, ordered by due time
+    struct timer_entry_t {
+        chrono::steady_clock::time_point due; // copy of the timer's due time when armed
+        shared_ptr<scheduled_timer_t> timer;
+        bool operator>(const timer_entry_t& other) const { return due > other.due; }
+    };
+    priority_queue<timer_entry_t, vector<timer_entry_t>, greater<timer_entry_t>> timers; // soonest on top
+    mutex timerLock;                        // protects timers and timerStop
+    condition_variable timerWake;           // wakes the timer thread for a sooner timer or shutdown
+    bool timerStop;                         // no timer fires or is armed from here on
+    thread tt;                              // timer thread handle, started by the first timer
+    
+    // Backpressure, only maintained when queueCapacity is set
+    size_t queueCapacity;                   // see ThreadPoolOptions
+    OverflowPolicy overflowPolicy;          // see ThreadPoolOptions
+    atomic<size_t> queued;                  // slots held by thunks queued and not yet started
+    atomic<size_t> blockedProducers;        // producers waiting on spaceFree
+    atomic<size_t> dropped;                 // thunks evicted by DropOldest, all time
+    mutex spaceLock;                        // pairs with spaceFree
+    condition_variable spaceFree;           // notified when a slot is released
+    
+    // Thunks that threw
+    function<void(exception_ptr)> errorHandler; // see ThreadPoolOptions
+    atomic<size_t> failures;                // thunks that ended with an exception, all time
     
     // Wait functionality
-    int activeTasks;                        // number of tasks currently being executed
+    atomic<size_t> outstanding;             // number of tasks scheduled but not yet completed
+    atomic<bool> discarding;                // set by shutdownNow: queued and new thunks are dropped
+    atomic<size_t> discarded;               // thunks dropped since shutdownNow began
     mutex waitLock;                         // mutex to protect wait state
     condition_variable allTasksDone;        // notify when all tasks are completed
     
@@ -0,0 +1,268 @@
+/**
+ * File: thunk.h
+ * -------------
+ * Defines the Thunk class, the move-only callable the ThreadPool stores in
+ * its queues instead of function<void(void)>, and the ThunkSlab allocator
+ * that backs the thunks too large to store inline.
+ *
+ * A Thunk keeps callables of up to kInlineSize bytes inside the object
+ * itself, so scheduling a lambda with a handful of captures never touches
+ * the heap.  Larger callables are placed in fixed-size blocks recycled by
+ * a pool-local ThunkSlab, and only callables that outgrow a slab block
+ * fall back to operator new.
+ *
+ * A callable may also have an abandon() member, which is called instead of
+ * running it when its owner drops the thunk (see Thunk::abandon), so that
+ * whoever waits on it can be told it will never run.
+ */
+
+#ifndef _thunk_
+#define _thunk_
+
+#include <cstddef>     // for size_t, nullptr_t, max_align_t
+#include <cstdint>     // for int64_t
+#include <new>         // for placement new
+#include <vector>      // for vector
+#include <mutex>       // for mutex
+#include <utility>     // for move, forward
+#include <type_traits> // for decay, enable_if, is_same, integral_constant
+
+using namespace std;
+
+/**
+ * @class ThunkSlab
+ * @brief A free list of fixed-size blocks for thunks that don't fit inline.
+ *
+ * Blocks are carved out of chunks that are only returned to the system
+ * when the slab is destroyed, so once a workload has reached its peak
+ * number of in-flight large thunks, allocate and deallocate never call
+ * malloc again.
+ */
+class ThunkSlab {
+  public:
+
+    static const size_t kBlockSize = 256;
+    static const size_t kBlocksPerChunk = 64;
+
+    ThunkSlab() : freeList(nullptr) {}
+
+    ~ThunkSlab() {
+        for (size_t i = 0; i < chunks.size(); i++) {
+            ::operator delete(chunks[i]);
+        }
+    }
+
+  /**
+  * Returns a block of kBlockSize bytes, aligned for any fundamental type.
+  */
+    void *allocate() {
+        lock_guard<mutex> lg(lock);
+        if (freeList == nullptr) refill();
+        block_t *block = freeList;
+        freeList = block->next;
+        return block;
+    }
+
+  /**
+  * Returns a block obtained from allocate() to the free list.
+  */
+    void deallocate(void *ptr) {
+        lock_guard<mutex> lg(lock);
+        block_t *block = static_cast<block_t *>(ptr);
+        block->next = freeList;
+        freeList = block;
+    }
+
+  private:
+
+    struct block_t {
+        block_t *next;
+    };
+
+    void refill() {
+        char *chunk = static_cast<char *>(::operator new(kBlockSize * kBlocksPerChunk));
+        chunks.push_back(chunk);
+        for (size_t i = 0; i < kBlocksPerChunk; i++) {
+            block_t *block = reinterpret_cast<block_t *>(chunk + i * kBlockSize);
+            block->next = freeList;
+            freeList = block;
+        }
+    }
+
+    block_t *freeList;                      // blocks ready to be handed out
+    vector<void *> chunks;                  // every chunk ever allocated, freed on destruction
+    mutex lock;                             // protects freeList and chunks
+
+    ThunkSlab(const ThunkSlab& original) = delete;
+    ThunkSlab& operator=(const ThunkSlab& rhs) = delete;
+};
+
+/**
+ * @class Thunk
+ * @brief A move-only, type-erased zero-argument callable with inline storage.
+ */
+class Thunk {
+  public:
+
+    static const size_t kInlineSize = 64;
+
+    Thunk() : ops(nullptr), target(nullptr), slab(nullptr), queuedAt(0) {}
+    Thunk(nullptr_t) : Thunk() {}
+
+  /**
+  * Wraps the callable f.  If it doesn't fit inline and a slab is given,
+  * it is stored in one of the slab's blocks.
+  */
+    template <typename F, typename Fn = typename decay<F>::type,
+              typename = typename enable_if<!is_same<Fn, Thunk>::value>::type>
+    Thunk(F&& f, ThunkSlab *slab = nullptr) : ops(&ops_for<Fn>::table), slab(nullptr), queuedAt(0) {
+        construct<Fn>(forward<F>(f), slab, integral_constant<bool, fitsInline<Fn>()>());
+    }
+
+    Thunk(Thunk&& other) : ops(nullptr), target(nullptr), slab(nullptr), queuedAt(0) {
+        steal(other);
+    }
+
+    Thunk& operator=(Thunk&& other) {
+        if (this != &other) {
+            reset();
+            steal(other);
+        }
+        return *this;
+    }
+
+    Thunk& operator=(nullptr_t) {
+        reset();
+        return *this;
+    }
+
+    ~Thunk() { reset(); }
+
+    void operator()() { ops->invoke(target); }
+
+  /**
+  * Destroys the callable without running it, calling its abandon() member
+  * first if it has one.  If abandon() throws, the thunk is still emptied.
+  */
+    void abandon() {
+        if (ops == nullptr) return;
+        try {
+            ops->abandon(target);
+        } catch (...) {
+            reset();
+            throw;
+        }
+        reset();
+    }
+
+    explicit operator bool() const { return ops != nullptr; }
+
+  /**
+  * When the thunk was queued, in steady_clock nanoseconds, or 0 if the
+  * owner didn't record it.  Travels with the thunk when it is moved.
+  */
+    int64_t enqueueTime() const { return queuedAt; }
+    void setEnqueueTime(int64_t nanos) { queuedAt = nanos; }
+
+  private:
+
+    struct ops_t {
+        void (*invoke)(void *target);
+        void (*abandon)(void *target);          // abandon() if the callable has one, else nothing
+        void (*relocate)(void *dst, void *src); // move-construct into dst, destroy src
+        void (*destroy)(void *target);          // run the destructor only
+        void (*destroyHeap)(void *target);      // run the destructor and operator delete
+    };
+
+    template <typename Fn>
+    struct ops_for {
+        static void invoke(void *target) { (*static_cast<Fn *>(target))(); }
+        static void abandon(void *target) { abandonIfAble(static_cast<Fn *>(target), 0); }
+        static void relocate(void *dst, void *src) {
+            new (dst) Fn(move(*static_cast<Fn *>(src)));
+            static_cast<Fn *>(src)->~Fn();
+        }
+        static void destroy(void *target) { static_cast<Fn *>(target)->~Fn(); }
+        static void destroyHeap(void *target) { delete static_cast<Fn *>(target); }
+        static const ops_t table;
+    };
+
+    template <typename Fn>
+    static auto abandonIfAble(Fn *fn, int) -> decltype(fn->abandon(), void()) { fn->abandon(); }
+    template <typename Fn>
+    static void abandonIfAble(Fn *, long) {}
+
+    template <typename Fn>
+    static constexpr bool fitsInline() {
+        return sizeof(Fn) <= kInlineSize && alignof(Fn) <= alignof(max_align_t) &&
+               is_nothrow_move_constructible<Fn>::value;
+    }
+
+    template <typename Fn, typename F>
+    void construct(F&& f, ThunkSlab *, true_type) {
+        target = new (storage) Fn(forward<F>(f));
+    }
+
+    template <typename Fn, typename F>
+    void construct(F&& f, ThunkSlab *slab, false_type) {
+        if (slab != nullptr && sizeof(Fn) <= ThunkSlab::kBlockSize &&
+            alignof(Fn) <= alignof(max_align_t)) {
+            target = new (slab->allocate()) Fn(forward<F>(f));
+            this->slab = slab;
+        } else {
+            target = new Fn(forward<F>(f));
+        }
+    }
+
+    bool isInline() const { return target == static_cast<const void *>(storage); }
+
+    void steal(Thunk& other) {
+        if (other.ops == nullptr) return;
+        ops = other.ops;
+        slab = other.slab;
+        queuedAt = other.queuedAt;
+        if (other.isInline()) {
+            ops->relocate(storage, other.storage);
+            target = storage;
+        } else {
+            target = other.target;
+        }
+        other.ops = nullptr;
+        other.target = nullptr;
+        other.slab = nullptr;
+        other.queuedAt = 0;
+    }
+
+    void reset() {
+        if (ops == nullptr) return;
+        if (isInline()) {
+            ops->destroy(target);
+        } else if (slab != nullptr) {
+            ops->destroy(target);
+            slab->deallocate(target);
+        } else {
+            ops->destroyHeap(target);
+        }
+        ops = nullptr;
+        target = nullptr;
+        slab = nullptr;
+        queuedAt = 0;
+    }
+
+    const ops_t *ops;                       // operations for the stored callable, null if empty
+    void *target;                           // the callable: storage, a slab block, or the heap
+    ThunkSlab *slab;                        // slab owning target, if it lives in one
+    int64_t queuedAt;                       // see enqueueTime()
+    alignas(max_align_t) unsigned char storage[kInlineSize];
+};
+
+template <typename Fn>
+const Thunk::ops_t Thunk::ops_for<Fn>::table = {
+    &Thunk::ops_for<Fn>::invoke,
+    &Thunk::ops_for<Fn>::abandon,
+    &Thunk::ops_for<Fn>::relocate,
+    &Thunk::ops_for<Fn>::destroy,
+    &Thunk::ops_for<Fn>::destroyHeap,
+};
+
+#endif
@@ -0,0 +1,168 @@
+/**
+ * File: tpbench.cc
+ * ----------------
+ * Microbenchmarks for the ThreadPool scheduler.  Every result is printed as
+ * one line of space-separated key=value pairs, starting with bench=<name>,
+ * so runs before and after a scheduler change can be diffed or loaded into
+ * a script directly.
+ *
+ * Usage: tpbench [-w workers] [-p maxProducers] [-q]
+ *   -w  worker threads per pool (default: hardware concurrency)
+ *   -p  largest producer count for the contention sweep (default: workers)
+ *   -q  quick run with fewer iterations, for smoke testing
+ */
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include "thread-pool.h"
+using namespace std;
+
+typedef chrono::steady_clock benchclock;
+
+static double secondsSince(benchclock::time_point start) {
+    return chrono::duration<double>(benchclock::now() - start).count();
+}
+
+static const char *backendName(QueueBackend backend) {
+    return backend == QueueBackend::LockFree ? "lockfree" : "locked";
+}
+
+/**
+ * Empty thunks scheduled from one outside thread as fast as possible,
+ * then drained; measures raw per-thunk scheduling overhead.
+ */
+static void throughputBench(size_t workers, QueueBackend backend, size_t ops) {
+    ThreadPool pool(workers, backend);
+    benchclock::time_point start = benchclock::now();
+    for (size_t i = 0; i < ops; i++) {
+        pool.schedule([] {});
+    }
+    pool.wait();
+    double secs = secondsSince(start);
+    cout << "bench=throughput backend=" << backendName(backend) << " workers=" << workers
+         << " ops=" << ops << " secs=" << secs << " ops_per_sec=" << (long long)(ops / secs) << endl;
+}
+
+/**
+ * Time from just before schedule() is called to the thunk starting, so it
+ * includes building the Thunk and queueing it; stamping after schedule()
+ * returns would race with a worker that already started it.  "idle" schedules
+ * one thunk at a time into a pool with parked workers, so it includes the
+ * wakeup; "burst" schedules them back to back, so it includes queueing.
+ */
+static void latencyBench(size_t workers, QueueBackend backend, size_t ops, bool burst) {
+    ThreadPool pool(workers, backend);
+    vector<int64_t> latencies(ops);
+    for (size_t i = 0; i < ops; i++) {
+        benchclock::time_point scheduled = benchclock::now();
+        pool.schedule([&latencies, i, scheduled] {
+            latencies[i] = chrono::duration_cast<chrono::nanoseconds>(benchclock::now() - scheduled).count();
+        });
+        if (!burst) {
+            pool.wait();
+        }
+    }
+    pool.wait();
+
+    sort(latencies.begin(), latencies.end());
+    cout << "bench=latency mode=" << (burst ? "burst" : "idle") << " backend=" << backendName(backend)
+         << " workers=" << workers << " ops=" << ops
+         << " p50_ns=" << latencies[ops * 50 / 100]
+         << " p90_ns=" << latencies[ops * 90 / 100]
+         << " p99_ns=" << latencies[ops * 99 / 100]
+         << " max_ns=" << latencies[ops - 1] << endl;
+}
+
+/**
+ * Rounds of `width` empty thunks followed by wait(); measures the cost of
+ * a fork/join barrier of that width.
+ */
+static void fanOutBench(size_t workers, size_t width, size_t rounds) {
+    ThreadPool pool(workers);
+    benchclock::time_point start = benchclock::now();
+    for (size_t r = 0; r < rounds; r++) {
+        for (size_t i = 0; i < width; i++) {
+            pool.schedule([] {});
+        }
+        pool.wait();
+    }
+    double secs = secondsSince(start);
+    cout << "bench=fanout workers=" << workers << " width=" << width << " rounds=" << rounds
+         << " ns_per_round=" << (long long)(secs * 1e9 / rounds) << endl;
+}
+
+/**
+ * `producers` outside threads scheduling empty thunks concurrently into
+ * one pool; measures how the queues hold up under producer contention.
+ */
+static void contentionBench(size_t workers, QueueBackend backend, size_t producers, size_t opsPerProducer) {
+    ThreadPool pool(workers, backend);
+    atomic<bool> go(false);
+    vector<thread> threads;
+    for (size_t p = 0; p < producers; p++) {
+        threads.push_back(thread([&pool, &go, opsPerProducer] {
+            while (!go) this_thread::yield();
+            for (size_t i = 0; i < opsPerProducer; i++) {
+                pool.schedule([] {});
+            }
+        }));
+    }
+
+    benchclock::time_point start = benchclock::now();
+    go = true;
+    for (size_t p = 0; p < producers; p++) {
+        threads[p].join();
+    }
+    pool.wait();
+    double secs = secondsSince(start);
+    size_t ops = producers * opsPerProducer;
+    cout << "bench=contention backend=" << backendName(backend) << " workers=" << workers
+         << " producers=" << producers << " ops=" << ops << " secs=" << secs
+         << " ops_per_sec=" << (long long)(ops / secs) << endl;
+}
+
+int main(int argc, char *argv[]) {
+    size_t workers = max(1u, thread::hardware_concurrency());
+    size_t maxProducers = 0;
+    bool quick = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+            workers = max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            maxProducers = max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "-q") == 0) {
+            quick = true;
+        } else {
+            cerr << "Usage: " << argv[0] << " [-w workers] [-p maxProducers] [-q]" << endl;
+            return 1;
+        }
+    }
+    if (maxProducers == 0) maxProducers = workers;
+    size_t scale = quick ? 10 : 1;
+
+    QueueBackend backends[] = { QueueBackend::Locked, QueueBackend::LockFree };
+    for (QueueBackend backend : backends) {
+        throughputBench(workers, backend, 1000000 / scale);
+    }
+    for (QueueBackend backend : backends) {
+        latencyBench(workers, backend, 10000 / scale, false);
+        latencyBench(workers, backend, 100000 / scale, true);
+    }
+    size_t widths[] = { 1, 16, 256, 4096 };
+    for (size_t width : widths) {
+        fanOutBench(workers, width, max((size_t)10, 400000 / width / scale));
+    }
+    for (QueueBackend backend : backends) {
+        for (size_t producers = 1; producers <= maxProducers; producers++) {
+            contentionBench(workers, backend, producers, 200000 / scale);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,206 @@
+/**
+ * File: tpcorotest.cc
+ * -------------------
+ * Tests for the coroutine layer in coro-task.h.  Built as C++20 by the
+ * tpcorotest target; everything else stays C++11.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <stdexcept>
+#include "thread-pool.h"
+#include "coro-task.h"
+
+using namespace std;
+
+static Task<int> square(ThreadPool& pool, int x) {
+    co_await pool.schedule();
+    co_return x * x;
+}
+
+static Task<int> sumOfSquares(ThreadPool& pool, int n) {
+    int total = 0;
+    for (int i = 1; i <= n; i++) {
+        total += co_await square(pool, i);
+    }
+    co_return total;
+}
+
+static bool scheduleAwaitTest() {
+    try {
+        ThreadPool pool(4);
+        return sync_wait(sumOfSquares(pool, 10)) == 385;
+    } catch (...) {
+        return false;
+    }
+}
+
+static Task<bool> runsOnWorker(ThreadPool& pool) {
+    co_await pool.schedule();
+    co_return pool.isWorkerThread();
+}
+
+static bool resumesOnWorkerTest() {
+    try {
+        ThreadPool pool(2);
+        return sync_wait(runsOnWorker(pool)) && !pool.isWorkerThread();
+    } catch (...) {
+        return false;
+    }
+}
+
+static Task<int> sleepy(ThreadPool& pool, int i) {
+    co_await pool.schedule();
+    this_thread::sleep_for(chrono::milliseconds(1));
+    co_return i;
+}
+
+static Task<long> fanOut(ThreadPool& pool, int n) {
+    vector<Task<int>> tasks;
+    for (int i = 0; i < n; i++) {
+        tasks.push_back(sleepy(pool, i));
+    }
+    vector<int> results = co_await when_all(pool, move(tasks));
+    long total = 0;
+    for (size_t i = 0; i < results.size(); i++) {
+        if (results[i] != (int)i) co_return -1;
+        total += results[i];
+    }
+    co_return total;
+}
+
+static bool whenAllTest() {
+    try {
+        ThreadPool pool(4);
+        return sync_wait(fanOut(pool, 100)) == 4950 && sync_wait(fanOut(pool, 0)) == 0;
+    } catch (...) {
+        return false;
+    }
+}
+
+static Task<void> bump(ThreadPool& pool, atomic<int>& counter) {
+    co_await pool.schedule();
+    counter++;
+}
+
+static Task<void> bumpAll(ThreadPool& pool, atomic<int>& counter, int n) {
+    vector<Task<void>> tasks;
+    for (int i = 0; i < n; i++) {
+        tasks.push_back(bump(pool, counter));
+    }
+    co_await when_all(pool, move(tasks));
+}
+
+// Many more logical tasks in flight than there are workers
+static bool manyInFlightTest() {
+    try {
+        ThreadPool pool(2);
+        atomic<int> counter(0);
+        sync_wait(bumpAll(pool, counter, 10000));
+        return counter == 10000;
+    } catch (...) {
+        return false;
+    }
+}
+
+static Task<int> failing(ThreadPool& pool, int i) {
+    co_await pool.schedule();
+    if (i == 3) throw runtime_error("boom");
+    co_return i;
+}
+
+static Task<int> collectFailing(ThreadPool& pool) {
+    vector<Task<int>> tasks;
+    for (int i = 0; i < 8; i++) {
+        tasks.push_back(failing(pool, i));
+    }
+    vector<int> results = co_await when_all(pool, move(tasks));
+    co_return (int)results.size();
+}
+
+static bool exceptionTest() {
+    try {
+        ThreadPool pool(4);
+        try {
+            sync_wait(collectFailing(pool));
+            return false;
+        } catch (const runtime_error& e) {
+            return string(e.what()) == "boom";
+        }
+    } catch (...) {
+        return false;
+    }
+}
+
+static Task<int> afterGate(ThreadPool& pool) {
+    co_await pool.schedule();
+    co_return 1;
+}
+
+// A coroutine whose resumption shutdownNow discards fails instead of hanging
+static bool shutdownTest() {
+    try {
+        ThreadPool pool(1);
+        atomic<bool> started(false), release(false);
+        pool.schedule([&started, &release] {
+            started = true;
+            while (!release) this_thread::sleep_for(chrono::milliseconds(1));
+        });
+        while (!started) this_thread::sleep_for(chrono::milliseconds(1));
+
+        atomic<bool> threw(false);
+        thread waiter([&pool, &threw] {
+            try {
+                sync_wait(afterGate(pool));
+            } catch (const runtime_error&) {
+                threw = true;
+            }
+        });
+        this_thread::sleep_for(chrono::milliseconds(20));
+        thread shutter([&pool] { pool.shutdownNow(); });
+        this_thread::sleep_for(chrono::milliseconds(20));
+        release = true;
+        shutter.join();
+        waiter.join();
+        return threw;
+    } catch (...) {
+        return false;
+    }
+}
+
+// Estructura para asociar nombre y función
+struct testEntry {
+    string name;
+    bool (*fn)();
+};
+
+int main() {
+    vector<testEntry> tests = {
+        {"co-await-schedule", scheduleAwaitTest},
+        {"resumes-on-worker", resumesOnWorkerTest},
+        {"when-all", whenAllTest},
+        {"many-in-flight", manyInFlightTest},
+        {"coroutine-exception", exceptionTest},
+        {"shutdown-now", shutdownTest},
+    };
+
+    int failed = 0;
+    for (const auto& test : tests) {
+        bool ok = false;
+        try {
+            ok = test.fn();
+        } catch (...) {
+            ok = false;
+        }
+        cout << left << setw(30) << test.name << (ok ? "OK" : "FAIL") << endl;
+        if (!ok) failed++;
+    }
+    cout << "----------------------------------------" << endl;
+    cout << "Resumen: " << failed << " test(s) fallaron de " << tests.size() << endl;
+    return failed;
+}
@@ -14,14 +14,23 @@
 #include <mutex>
 #include <atomic>
 #include <vector>
+#include <array>
 #include <chrono>
 #include <sys/types.h>
 #include <unistd.h> 
+#include <sched.h>
 #include <dirent.h> 
 #include <exception>
 #include <iomanip>
+#include <future>
+#include <cstdlib>
+#include <new>
+#include <algorithm>
 
 #include "thread-pool.h"
+#include "parallel.h"
+#include "task-group.h"
+#include "task-graph.h"
 
 using namespace std;
 
@@ -31,6 +40,25 @@ void sleep_for(int slp){
 
 static mutex oslock;
 
+// Every heap allocation made by the process, counted so tests can check
+// that the pool's steady-state scheduling path never touches the heap
+static atomic<size_t> allocationCount(0);
+
+void *operator new(size_t size) {
+    allocationCount++;
+    void *ptr = malloc(size == 0 ? 1 : size);
+    if (ptr == nullptr) throw bad_alloc();
+    return ptr;
+}
+
+void operator delete(void *ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+    free(ptr);
+}
+
 static const size_t kNumThreads = 4;
 static const size_t kNumFunctions = 10;
 
@@ -243,8 +271,115 @@ static bool memoryUsageTest() {
                     sleep_for(10);
                 });
             }
+            // Too big to store inline, so it lands in the pool's slab
+            array<int, 32> payload;
+            payload.fill(i);
+            pool.schedule([&taskCount, payload] { taskCount += payload[0] - payload[31]; });
             pool.wait();
             if (taskCount.load() != 10) return false;
+
+            // Once the queues have grown to fit the batch, scheduling the
+            // same batch again must not allocate at all
+            size_t allocationsBefore = allocationCount.load();
+            for (int j = 0; j < 10; j++) {
+                pool.schedule([&taskCount, i, j] {
+                    taskCount++;
+                    sleep_for(10);
+                });
+            }
+            pool.schedule([&taskCount, payload] { taskCount += payload[0] - payload[31]; });
+            pool.wait();
+            if (allocationCount.load() != allocationsBefore) return false;
+            if (taskCount.load() != 20) return false;
+        }
+        return true;
+    } catch (...) {
+        return false;
+    }
+}
+
+static bool nestedScheduleTest() {
+    try {
+        ThreadPool pool(4);
+        atomic<int> counter(0);
+        for (int i = 0; i < 8; i++) {
+            pool.schedule([&pool, &counter] {
+                for (int j = 0; j < 25; j++) {
+                    pool.schedule([&counter] {
+                        counter++;
+                        sleep_for(1);
+                    });
+                }
+                counter++;
+            });
+        }
+        pool.wait();
+        return counter.load() == 8 * 26;
+    } catch (...) {
+        return false;
+    }
+}
+
+static bool lockFreeQueueTest() {
+    try {
+        ThreadPool pool(4, QueueBackend::LockFree);
+        atomic<int> counter(0);
+        vector<thread> schedulers;
+        for (int i = 0; i < 4; i++) {
+            schedulers.emplace_back([&pool, &counter] {
+                // Enough thunks per producer to overflow the ring
+                for (int j = 0; j < 2000; j++) {
+                    pool.schedule([&counter] { counter++; });
+                }
+            });
+        }
+        for (auto& scheduler : schedulers) {
+            scheduler.join();
+        }
+        pool.wait();
+        return counter.load() == 8000;
+    } catch (...) {
+        return false;
+    }
+}
+
+static bool submitTest() {
+    try {
+        ThreadPool pool(4);
+        vector<future<int>> squares;
+        for (int i = 0; i < 20; i++) {
+            squares.push_back(pool.submit([](int x) { sleep_for(x % 3); return x * x; }, i));
+        }
+        future<void> failing = pool.submit([] { throw runtime_error("Simulated error in task"); });
+        for (int i = 0; i < 20; i++) {
+            if (squares[i].get() != i * i) return false;
+        }
+        try {
+            failing.get();
+            return false;
+        } catch (const runtime_error&) {}
+        pool.wait();
+        return true;
+    } catch (...) {
+        return false;
+    }
+}
+
+static bool parallelForTest() {
+    try {
+        ThreadPool pool(4);
+        const int n = 1000;
+        vector<atomic<int>> visits(n);
+        for (auto& visit : visits) visit = 0;
+        // Skewed work: the last indices are much more expensive
+        parallel_for(pool, 0, n, [&visits](int lo, int hi) {
+            for (int i = lo; i < hi; i++) {
+                if (i > 900) sleep_for(1);
+                visits[i]++;
+            }
+        });
+        for (int i = 0; i < n; i++) {
+            if (visits[i].load() != 1) return false;
         }
         return true;
     } catch (...) {
@@ -252,6 +387,759 @@ static bool memoryUsageTest() {
     }
 }
 
+static bool parallelReduceTest() {
+    try {
+        ThreadPool pool(4);
+        long sum = parallel_reduce(pool, 1L, 100001L, 0L,
+            [](long lo, long hi, long acc) {
+                for (long i = lo; i < hi; i++) acc += i;
+                return acc;
+            },
+            [](long a, long b) { return a + b; });
+        if (sum != 100000L * 100001L / 2) return false;
+
+        // Concatenation is not commutative, so this checks partials are combined in order
+        string digits = parallel_reduce(pool, 0, 100, 7, string(),
+            [](int lo, int hi, string acc) {
+                for (int i = lo; i < hi; i++) acc += (char)('0' + i % 10);
+                return acc;
+            },
+            [](const string& a, const string& b) { return a + b; });
+        for (int i = 0; i < 100; i++) {
+            if (digits[i] != '0' + i % 10) return false;
+        }
+
+        // bool partials must not share storage between chunks
+        bool allEven = parallel_reduce(pool, 0, 10000, 1, true,
+            [](int lo, int hi, bool acc) { return acc && (lo * 2) % 2 == 0; },
+            [](bool a, bool b) { return a && b; });
+        if (!allEven) return false;
+
+        // Nested inside a running thunk, the waiting worker helps instead of blocking
+        atomic<int> nestedTotal(0);
+        for (int t = 0; t < 4; t++) {
+            pool.schedule([&pool, &nestedTotal] {
+                nestedTotal += parallel_reduce(pool, 0, 64, 0,
+                    [](int lo, int hi, int acc) { return acc + (hi - lo); },
+                    [](int a, int b) { return a + b; });
+            });
+        }
+        pool.wait();
+        return digits.size() == 100 && nestedTotal.load() == 4 * 64;
+    } catch (...) {
+        return false;
+    }
+}
+
+static bool taskGroupTest() {
+    try {
+        ThreadPool pool(4);
+        TaskGroup slow(pool), fast(pool);
+        atomic<int> slowDone(0), fastDone(0);
+        for (int i = 0; i < 2; i++) {
+            slow.schedule([&slowDone] {
+                sleep_for(500);
+                slowDone++;
+            });
+        }
+        for (int i = 0; i < 10; i++) {
+            fast.schedule([&fastDone] {
+                sleep_for(5);
+                fastDone++;
+            });
+        }
+        fast.schedule([] { throw runtime_error("Simulated error in task"); });
+
+        // Waiting on the fast group must not wait for the slow one
+        auto start = chrono::steady_clock::now();
+        bool caught = false;
+        try {
+            fast.wait();
+        } catch (const runtime_error&) {
+            caught = true;
+        }
+        auto elapsed = chrono::steady_clock::now() - start;
+        if (!caught || fastDone.load() != 10 || slowDone.load() != 0) return false;
+        if (elapsed >= chrono::milliseconds(400)) return false;
+
+        slow.wait();
+        return slowDone.load() == 2;
+    } catch (...) {
+        return false;
+    }
+}
+
+static bool priorityTest() {
+    try {
+        ThreadPool pool(1);
+        mutex orderLock;
+        string order;
+        auto record = [&orderLock, &order](char label) {
+            lock_guard<mutex> lg(orderLock);
+            order += label;
+        };
+
+        // Keep the only worker busy while the lanes fill up
+        pool.schedule([] { sleep_for(200); });
+        sleep_for(50);
+        for (int i = 0; i < 40; i++) {
+            pool.schedule([&record] { record('n'); });
+            pool.schedule([&record] { record('l'); }, Priority::Low);
+        }
+        pool.schedule([&record] { record('h'); }, Priority::High);
+        pool.wait();
+
+        // The urgent thunk jumps the queue, and the low lane is not starved
+        // until the normal one drains
+        if (order.size() != 81) return false;
+        if (order.find('h') > 2) return false;
+        return order.find('l') < order.rfind('n');
+    } catch (...) {
+        return false;
+    }
+}
+
+static bool affinityTest() {
+    try {
+        // Pin to a CPU this process is actually allowed to run on
+        cpu_set_t allowed;
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) return false;
+        int cpu = 0;
+        while (cpu < CPU_SETSIZE && !CPU_ISSET(cpu, &allowed)) cpu++;
+        if (cpu == CPU_SETSIZE) return false;
+
+        atomic<int> pinErrors(0);
+        ThreadPoolOptions pinnedOptions(2);
+        pinnedOptions.cpus = {cpu};
+        pinnedOptions.errorHandler = [&pinErrors](exception_ptr) { pinErrors++; };
+        ThreadPool pinned(pinnedOptions);
+        for (int i = 0; i < 10; i++) {
+            if (pinned.submit([] { return sched_getcpu(); }).get() != cpu) return false;
+        }
+        if (pinErrors.load() != 0) return false;
+
+        atomic<int> counter(0);
+        ThreadPoolOptions nodeOptions(4);
+        nodeOptions.numaNode = 0;
+        ThreadPoolOptions spreadOptions(4);
+        spreadOptions.spreadAcrossNodes = true;
+        spreadOptions.backend = QueueBackend::LockFree;
+        ThreadPool onNode(nodeOptions), spread(spreadOptions);
+        for (int i = 0; i < 100; i++) {
+            onNode.schedule([&counter] { counter++; });
+            spread.schedule([&spread, &counter] {
+                spread.schedule([&counter] { counter++; });
+            });
+        }
+        onNode.wait();
+        spread.wait();
+        if (counter.load() != 200) return false;
+
+        ThreadPoolOptions badOptions(2);
+        badOptions.cpus = {1 << 20};
+        try {
+            ThreadPool bad(badOptions);
+            return false;
+        } catch (const invalid_argument&) {}
+        return true;
+    } catch (...) {
+        return false;
+    }
+}
+
+static bool spinSemaphoreTest() {
+    try {
+        SpinSemaphore ping(0), pong(0);
+        int rounds = 0;
+        thread partner([&ping, &pong, &rounds] {
+            for (int i = 0; i < 10000; i++) {
+                ping.wait();
+                rounds++;
+                pong.signal();
+            }
+        });
+        for (int i = 0; i < 10000; i++) {
+            ping.signal();
+            pong.wait();
+        }
+        partner.join();
+
+        // A count banked before anyone waits is not lost
+        SpinSemaphore banked(0);
+        banked.signal();
+        banked.signal();
+        banked.wait();
+        banked.wait();
+        return rounds == 10000;
+    } catch (...) {
+        return false;
+    }
+}
+
+static bool elasticTest() {
+    try {
+        ThreadPoolOptions options(1);
+        options.maxThreads = 4;
+        options.growQueueDepth = 2;
+        options.growAfter = chrono::milliseconds(20);
+        options.idleTimeout = chrono::milliseconds(100);
+        ThreadPool pool(options);
+
+        // Thunks that block (as if on I/O) make the pool grow instead of
+        // running one after another on the only initial worker
+        auto start = chrono::steady_clock::now();
+        for (int i = 0; i < 4; i++) {
+            pool.schedule([] { sleep_for(300); });
+        }
+        pool.wait();
+        auto elapsed = chrono::steady_clock::now() - start;
+        if (elapsed >= chrono::milliseconds(900)) return false;
+        if (pool.size() < 2 || pool.size() > 4) return false;
+
+        // Once idle, the extra workers retire down to the minimum
+        sleep_for(500);
+        if (pool.size() != 1) return false;
+
+        // ...and the pool can grow again afterwards
+        atomic<int> counter(0);
+        for (int i = 0; i < 20; i++) {
+            pool.schedule([&counter] {
+                sleep_for(20);
+                counter++;
+            });
+        }
+        pool.wait();
+        return counter.load() == 20;
+    } catch (...) {
+        return false;
+    }
+}
+
+// Adds one to the counter when run; copying one marked faulty throws
+struct throwing_copy_t {
+    atomic<int> *counter;
+    bool faulty;
+
+    throwing_copy_t(atomic<int> *counter, bool faulty) : counter(counter), faulty(faulty) {}
+    throwing_copy_t(const throwing_copy_t& other) : counter(other.counter), faulty(other.faulty) {
+        if (faulty) throw runtime_error("copy failed");
+    }
+    throwing_copy_t(throwing_copy_t&& other) noexcept : counter(other.counter), faulty(other.faulty) {}
+    void operator()() { (*counter)++; }
+};
+
+static bool bulkScheduleTest() {
+    try {
+        ThreadPool pool(4);
+        atomic<int> counter(0);
+        vector<function<void(void)>> batch;
+        for (int i = 0; i < 1000; i++) {
+            batch.push_back([&counter] { counter++; });
+        }
+        pool.scheduleBulk(batch.begin(), batch.end());
+        pool.schedule({
+            [&counter] { counter += 10; },
+            [&counter] { counter += 100; },
+        }, Priority::High);
+
+        // A batch scheduled from inside a thunk lands on that worker's deque
+        pool.schedule([&pool, &batch] { pool.scheduleBulk(batch.begin(), batch.end()); });
+        pool.wait();
+        if (counter.load() != 2110) return false;
+
+        // A copy that throws partway leaves the earlier thunks scheduled,
+        // and wait() doesn't count the ones that never made it in
+        vector<throwing_copy_t> faulty;
+        for (int i = 0; i < 10; i++) {
+            faulty.push_back(throwing_copy_t(&counter, i == 5));
+        }
+        try {
+            pool.scheduleBulk(faulty.begin(), faulty.end());
+            return false;
+        } catch (const runtime_error&) {}
+        return pool.tryWaitFor(chrono::milliseconds(5000)) && counter.load() == 2115;
+    } catch (...) {
+        return false;
+    }
+}
+
+static bool statsTest() {
+    try {
+        ThreadPoolOptions options(4);
+        options.collectStats = true;
+        ThreadPool pool(options);
+        atomic<int> counter(0);
+        for (int i = 0; i < 500; i++) {
+            pool.schedule([&counter] { counter++; });
+        }
+        vector<function<void(void)>> batch(100, [&counter] { counter++; });
+        pool.scheduleBulk(batch.begin(), batch.end());
+        pool.wait();
+
+        ThreadPoolStats stats = pool.stats();
+        size_t perWorker = 0;
+        for (size_t i = 0; i < stats.workers.size(); i++) {
+            perWorker += stats.workers[i].executed;
+        }
+        ostringstream line;
+        line << stats;
+
+        // The periodic dump goes to the given stream from the supervisor
+        ostringstream dump;
+        {
+            ThreadPoolOptions dumping(2);
+            dumping.statsInterval = chrono::milliseconds(5);
+            dumping.statsStream = &dump;
+            ThreadPool dumper(dumping);
+            dumper.schedule([] { this_thread::sleep_for(chrono::milliseconds(30)); });
+            dumper.wait();
+        }
+        return dump.str().find("workers=2") != string::npos &&
+               counter.load() == 600 && stats.executed == 600 && perWorker == 600 &&
+               stats.queueWait.count() == 600 && stats.runTime.count() == 600 &&
+               stats.queueDepth == 0 && stats.outstanding == 0 && stats.liveWorkers == 4 &&
+               stats.queueWait.percentile(50) <= stats.queueWait.percentile(99) &&
+               line.str().find("executed=600") != string::npos;
+    } catch (...) {
+        return false;
+    }
+}
+
+static bool timerTest() {
+    try {
+        // A single worker stays free while the delayed thunk waits
+        ThreadPool pool(1);
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        atomic<long> firedAfter(-1);
+        pool.scheduleAfter(chrono::milliseconds(100), [&firedAfter, start] {
+            firedAfter = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+        });
+        atomic<bool> ran(false);
+        pool.schedule([&ran] { ran = true; });
+        pool.wait();
+        bool notPinned = ran && firedAfter == -1;
+
+        // Cancelled before it is due: never runs
+        atomic<int> cancelledRuns(0);
+        TimerHandle handle = pool.scheduleAfter(chrono::milliseconds(50), [&cancelledRuns] { cancelledRuns++; });
+        handle.cancel();
+
+        // Periodic until cancelled, never overlapping with itself
+        atomic<int> ticks(0);
+        atomic<int> inside(0);
+        atomic<bool> overlapped(false);
+        TimerHandle heartbeat = pool.scheduleEvery(chrono::milliseconds(10), [&ticks, &inside, &overlapped] {
+            if (inside++ != 0) overlapped = true;
+            ticks++;
+            inside--;
+        });
+        sleep_for(200);
+        heartbeat.cancel();
+        pool.wait();
+        int ticksAtCancel = ticks;
+        sleep_for(50);
+
+        bool rejected = false;
+        try {
+            pool.scheduleEvery(chrono::milliseconds(0), [] {});
+        } catch (const invalid_argument&) {
+            rejected = true;
+        }
+        return notPinned && firedAfter >= 100 && cancelledRuns == 0 && handle.cancelled() &&
+               ticks >= 5 && ticks == ticksAtCancel && !overlapped && rejected;
+    } catch (...) {
+        return false;
+    }
+}
+
+static bool taskGraphTest() {
+    try {
+        ThreadPool pool(4);
+
+        // Diamond a -> {b, c} -> d, plus a chain d -> e -> f; every node
+        // records the step it ran at, which must follow its predecessors'
+        atomic<int> clock(0);
+        vector<int> order(6, -1);
+        TaskGraph graph(pool);
+        vector<size_t> ids;
+        for (int i = 0; i < 6; i++) {
+            ids.push_back(graph.addNode([&order, &clock, i] {
+                sleep_for(i == 1 ? 20 : 1);
+                order[i] = clock++;
+            }));
+        }
+        graph.addEdge(ids[0], ids[1]);
+        graph.addEdge(ids[0], ids[2]);
+        graph.addEdge(ids[1], ids[3]);
+        graph.addEdge(ids[2], ids[3]);
+        graph.addEdge(ids[3], ids[4]);
+        graph.addEdge(ids[4], ids[5]);
+
+        // Reusable: every run reruns every node in dependency order
+        bool ordered = true;
+        for (int run = 0; run < 20; run++) {
+            graph.run();
+            ordered = ordered && order[0] < order[1] && order[0] < order[2] && order[1] < order[3] &&
+                      order[2] < order[3] && order[3] < order[4] && order[4] < order[5];
+        }
+        bool allRan = clock == 6 * 20;
+
+        // A throwing node skips what depends on it and surfaces from run()
+        TaskGraph failing(pool);
+        atomic<int> after(0);
+        size_t bad = failing.addNode([] { throw runtime_error("stage failed"); });
+        size_t next = failing.addNode([&after] { after++; });
+        failing.addEdge(bad, next);
+        bool rethrown = false;
+        try {
+            failing.run();
+        } catch (const runtime_error&) {
+            rethrown = true;
+        }
+
+        // Cycles are refused before anything runs
+        TaskGraph cyclic(pool);
+        atomic<int> cyclicRuns(0);
+        size_t x = cyclic.addNode([&cyclicRuns] { cyclicRuns++; });
+        size_t y = cyclic.addNode([&cyclicRuns] { cyclicRuns++; });
+        cyclic.addEdge(x, y);
+        cyclic.addEdge(y, x);
+        bool refused = false;
+        try {
+            cyclic.run();
+        } catch (const logic_error&) {
+            refused = true;
+        }
+        return ordered && allRan && rethrown && after == 0 && refused && cyclicRuns == 0;
+    } catch (...) {
+        return false;
+    }
+}
+
+static bool cancellationTest() {
+    try {
+        // Tokens cancelled before the thunk starts skip it
+        ThreadPool pool(1);
+        CancellationToken token;
+        atomic<int> ran(0);
+        pool.schedule([] { sleep_for(50); });
+        for (int i = 0; i < 10; i++) {
+            pool.schedule([&ran] { ran++; }, token);
+        }
+        token.cancel();
+        CancellationToken other;
+        pool.schedule([&ran] { ran += 100; }, other, Priority::Low);
+        pool.wait();
+        bool skipped = ran == 100 && token.cancelled() && !other.cancelled();
+
+        // tryWaitFor gives up on work that takes longer than the timeout
+        pool.schedule([] { sleep_for(100); });
+        bool timedOut = !pool.tryWaitFor(chrono::milliseconds(10));
+        bool finished = pool.tryWaitFor(chrono::milliseconds(2000));
+        return skipped && timedOut && finished;
+    } catch (...) {
+        return false;
+    }
+}
+
+static bool shutdownNowTest() {
+    try {
+        ThreadPool pool(2);
+        atomic<int> started(0);
+        atomic<int> ran(0);
+        for (int i = 0; i < 2; i++) {
+            pool.schedule([&started] {
+                started++;
+                sleep_for(100);
+            });
+        }
+        while (started < 2) sleep_for(1);
+        for (int i = 0; i < 1000; i++) {
+            pool.schedule([&ran] { ran++; });
+        }
+        future<int> result = pool.submit([] { return 1; });
+        atomic<int> timerRuns(0);
+        pool.scheduleAfter(chrono::milliseconds(10), [&timerRuns] { timerRuns++; });
+
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        size_t discarded = pool.shutdownNow();
+        long elapsed = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+
+        // Work scheduled after shutdown is dropped as well
+        pool.schedule([&ran] { ran++; });
+        bool broken = false;
+        try {
+            result.get();
+        } catch (const future_error&) {
+            broken = true;
+        }
+        return discarded == 1001 && ran == 0 && timerRuns == 0 && broken && elapsed < 1000 &&
+               pool.tryWaitFor(chrono::milliseconds(0));
+    } catch (...) {
+        return false;
+    }
+}
+
+// Occupies the pool's only worker until the returned flag is set
+static shared_ptr<atomic<bool>> blockWorker(ThreadPool& pool) {
+    shared_ptr<atomic<bool>> release = make_shared<atomic<bool>>(false);
+    shared_ptr<atomic<bool>> started = make_shared<atomic<bool>>(false);
+    pool.schedule([release, started] {
+        *started = true;
+        while (!*release) sleep_for(1);
+    });
+    while (!*started) sleep_for(1);
+    return release;
+}
+
+static bool shutdownNowWaitersTest() {
+    try {
+        // A TaskGroup whose thunks are discarded still finishes waiting
+        bool groupOk = false;
+        {
+            ThreadPool pool(1);
+            shared_ptr<atomic<bool>> release = blockWorker(pool);
+            TaskGroup group(pool);
+            atomic<int> ran(0);
+            for (int i = 0; i < 5; i++) {
+                group.schedule([&ran] { ran++; });
+            }
+            size_t discarded = 0;
+            thread shutter([&pool, &discarded] { discarded = pool.shutdownNow(); });
+            sleep_for(20);
+            *release = true;
+            shutter.join();
+            try {
+                group.wait();
+            } catch (const runtime_error&) {
+                groupOk = ran == 0 && discarded == 5;
+            }
+        }
+
+        // A worker can't shut down its own pool
+        ThreadPool pool(2);
+        bool rejected = pool.submit([&pool] {
+            try {
+                pool.shutdownNow();
+                return false;
+            } catch (const logic_error&) {
+                return true;
+            }
+        }).get();
+        return groupOk && rejected;
+    } catch (...) {
+        return false;
+    }
+}
+
+static bool backpressureTest() {
+    try {
+        const size_t kCapacity = 4;
+        ThreadPoolOptions options(1);
+        options.queueCapacity = kCapacity;
+
+        // trySchedule refuses once the queue is full
+        bool tryOk;
+        {
+            ThreadPool pool(options);
+            shared_ptr<atomic<bool>> release = blockWorker(pool);
+            atomic<int> ran(0);
+            size_t accepted = 0;
+            for (int i = 0; i < 10; i++) {
+                if (pool.trySchedule([&ran] { ran++; })) accepted++;
+            }
+            *release = true;
+            pool.wait();
+            tryOk = accepted == kCapacity && ran == (int)kCapacity;
+        }
+
+        // Block holds the producer until the worker frees a slot
+        bool blockOk;
+        {
+            ThreadPool pool(options);
+            shared_ptr<atomic<bool>> release = blockWorker(pool);
+            atomic<int> ran(0);
+            atomic<int> returned(0);
+            thread producer([&pool, &ran, &returned] {
+                for (int i = 0; i < 10; i++) {
+                    pool.schedule([&ran] { ran++; });
+                    returned++;
+                }
+            });
+            sleep_for(50);
+            bool held = returned == (int)kCapacity;
+            *release = true;
+            producer.join();
+            pool.wait();
+            blockOk = held && ran == 10;
+        }
+
+        // CallerRuns runs the overflow on the producer's thread
+        bool callerOk;
+        {
+            ThreadPoolOptions callerRuns = options;
+            callerRuns.overflowPolicy = OverflowPolicy::CallerRuns;
+            ThreadPool pool(callerRuns);
+            shared_ptr<atomic<bool>> release = blockWorker(pool);
+            atomic<int> onCaller(0);
+            thread::id self = this_thread::get_id();
+            for (int i = 0; i < 10; i++) {
+                pool.schedule([&onCaller, self] {
+                    if (this_thread::get_id() == self) onCaller++;
+                });
+            }
+            *release = true;
+            pool.wait();
+            callerOk = onCaller == 10 - (int)kCapacity;
+        }
+
+        // DropOldest keeps the newest thunks
+        bool dropOk;
+        {
+            ThreadPoolOptions dropOldest = options;
+            dropOldest.overflowPolicy = OverflowPolicy::DropOldest;
+            ThreadPool pool(dropOldest);
+            shared_ptr<atomic<bool>> release = blockWorker(pool);
+            mutex m;
+            vector<int> ranIds;
+            for (int i = 0; i < 10; i++) {
+                pool.schedule([&m, &ranIds, i] {
+                    lock_guard<mutex> lg(m);
+                    ranIds.push_back(i);
+                });
+            }
+            *release = true;
+            pool.wait();
+            dropOk = ranIds == vector<int>({6, 7, 8, 9}) && pool.stats().dropped == 10 - kCapacity;
+        }
+        return tryOk && blockOk && callerOk && dropOk;
+    } catch (...) {
+        return false;
+    }
+}
+
+static bool dropOldestOwnersTest() {
+    try {
+        ThreadPoolOptions options(1);
+        options.queueCapacity = 2;
+        options.overflowPolicy = OverflowPolicy::DropOldest;
+
+        // Evicted TaskGroup thunks still count as finished
+        bool groupOk = false;
+        {
+            ThreadPool pool(options);
+            shared_ptr<atomic<bool>> release = blockWorker(pool);
+            TaskGroup group(pool);
+            atomic<int> ran(0);
+            for (int i = 0; i < 5; i++) {
+                group.schedule([&ran] { ran++; });
+            }
+            *release = true;
+            try {
+                group.wait();
+            } catch (const runtime_error&) {
+                groupOk = ran == 2;
+            }
+        }
+
+        // Normal work in a worker's deque goes before high priority work
+        bool orderOk;
+        {
+            ThreadPool pool(options);
+            mutex m;
+            vector<string> ranNames;
+            auto record = [&m, &ranNames](const string& name) {
+                lock_guard<mutex> lg(m);
+                ranNames.push_back(name);
+            };
+            pool.schedule([&pool, &record] {
+                pool.schedule([&record] { record("high"); }, Priority::High);
+                pool.schedule([&record] { record("first"); });
+                pool.schedule([&record] { record("second"); });
+            });
+            pool.wait();
+            orderOk = ranNames.size() == 2 &&
+                      find(ranNames.begin(), ranNames.end(), "high") != ranNames.end() &&
+                      find(ranNames.begin(), ranNames.end(), "second") != ranNames.end();
+        }
+
+        // An evicted firing doesn't stop a periodic timer for good
+        bool timerOk = false;
+        {
+            ThreadPool pool(options);
+            shared_ptr<atomic<bool>> release = blockWorker(pool);
+            atomic<int> runs(0);
+            TimerHandle timer = pool.scheduleEvery(chrono::milliseconds(5), [&runs] { runs++; });
+            sleep_for(20);
+            for (int i = 0; i < 3; i++) {
+                pool.schedule([] {});
+            }
+            *release = true;
+            for (int i = 0; i < 1000 && !timerOk; i++) {
+                timerOk = runs >= 2;
+                sleep_for(1);
+            }
+            timer.cancel();
+        }
+        return groupOk && orderOk && timerOk;
+    } catch (...) {
+        return false;
+    }
+}
+
+static bool workerExceptionTest() {
+    try {
+        // Uncaught exceptions reach the handler and the workers survive
+        mutex m;
+        vector<string> messages;
+        ThreadPoolOptions options(2);
+        options.errorHandler = [&m, &messages](exception_ptr error) {
+            try {
+                rethrow_exception(error);
+            } catch (const exception& e) {
+                lock_guard<mutex> lg(m);
+                messages.push_back(e.what());
+            }
+        };
+        ThreadPool pool(options);
+        atomic<int> successCount(0);
+        for (int i = 0; i < 100; i++) {
+            pool.schedule([&successCount, i] {
+                if (i % 10 == 3) throw runtime_error("Simulated error in task");
+                successCount++;
+            });
+        }
+        pool.wait();
+
+        // A periodic thunk keeps firing after it throws
+        atomic<int> ticks(0);
+        TimerHandle timer = pool.scheduleEvery(chrono::milliseconds(5), [&ticks] {
+            ticks++;
+            throw runtime_error("tick");
+        });
+        while (ticks < 3) sleep_for(1);
+        timer.cancel();
+        pool.wait();
+
+        // submit still reports through its future, not the handler
+        future<int> result = pool.submit([]() -> int { throw logic_error("via future"); });
+        bool viaFuture = false;
+        try {
+            result.get();
+        } catch (const logic_error&) {
+            viaFuture = true;
+        }
+        pool.wait();
+
+        lock_guard<mutex> lg(m);
+        size_t failed = pool.stats().failed;
+        return successCount == 90 && messages.size() == failed && failed >= 13 && viaFuture &&
+               messages[0] == "Simulated error in task" && pool.size() == 2;
+    } catch (...) {
+        return false;
+    }
+}
+
 // Estructura para asociar nombre y función
 struct testEntry {
     string name;
@@ -272,6 +1160,26 @@ int main() {
         {"exception-handle", exceptionHandleTest},
         {"rapid-schedule-wait", rapidScheduleWaitTest},
         {"memory-usage", memoryUsageTest},
+        {"nested-schedule", nestedScheduleTest},
+        {"lock-free-queue", lockFreeQueueTest},
+        {"submit", submitTest},
+        {"parallel-for", parallelForTest},
+        {"parallel-reduce", parallelReduceTest},
+        {"task-group", taskGroupTest},
+        {"priority", priorityTest},
+        {"affinity", affinityTest},
+        {"spin-semaphore", spinSemaphoreTest},
+        {"elastic", elasticTest},
+        {"bulk-schedule", bulkScheduleTest},
+        {"stats", statsTest},
+        {"timer", timerTest},
+        {"task-graph", taskGraphTest},
+        {"cancellation", cancellationTest},
+        {"shutdown-now", shutdownNowTest},
+        {"shutdown-now-waiters", shutdownNowWaitersTest},
+        {"backpressure", backpressureTest},
+        {"drop-oldest-owners", dropOldestOwnersTest},
+        {"worker-exception", workerExceptionTest},
     };
 
     int failed = 0;
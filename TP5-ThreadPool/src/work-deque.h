@@ -0,0 +1,142 @@
+/**
+ * File: work-deque.h
+ * ------------------
+ * Defines the WorkDeque class template, the per-worker task deque used by
+ * the ThreadPool for work stealing.  It follows the Chase-Lev protocol: the
+ * owning worker pushes and pops at the bottom (LIFO, cache-warm), while idle
+ * peers steal from the top (FIFO, oldest work first).
+ *
+ * Elements are arbitrary movable objects rather than raw pointers, so each
+ * deque is guarded by its own mutex instead of the lock-free top/bottom CAS
+ * of the original paper.  The lock is only ever contended when a thief and
+ * the owner race for the same deque; an atomic size lets thieves skip empty
+ * deques without touching the lock at all.  Since every operation takes the
+ * lock, any thread may push, pop or steal: the pool's shared priority lanes
+ * are WorkDeques pushed to by every producer.
+ */
+
+#ifndef _work_deque_
+#define _work_deque_
+
+#include <cstddef>     // for size_t
+#include <vector>      // for vector
+#include <mutex>       // for mutex
+#include <atomic>      // for atomic
+#include <utility>     // for move
+
+using namespace std;
+
+template <typename T>
+class WorkDeque {
+  public:
+
+  /**
+  * Constructs an empty deque with room for the specified number of
+  * elements (rounded up to a power of two) before it has to grow.
+  */
+    WorkDeque(size_t initialCapacity = 64) : top(0), bottom(0), count(0) {
+        size_t capacity = 1;
+        while (capacity < initialCapacity) capacity <<= 1;
+        buffer.resize(capacity);
+    }
+
+  /**
+  * Pushes an element at the bottom of the deque.  Returns true if the
+  * deque was empty before the push.  Safe to call from any thread.
+  */
+    bool push(T&& elem) {
+        lock_guard<mutex> lg(lock);
+        if (bottom - top == buffer.size()) grow();
+        buffer[bottom & (buffer.size() - 1)] = move(elem);
+        bottom++;
+        count.store(bottom - top, memory_order_seq_cst);
+        return bottom - top == 1;
+    }
+
+  /**
+  * Pushes n elements at the bottom of the deque under a single lock
+  * acquisition, taking each one from gen().  Returns true if the deque
+  * was empty before the push.  If gen() throws, the elements it already
+  * produced stay queued and the exception propagates.
+  */
+    template <typename Gen>
+    bool pushAll(size_t n, Gen gen) {
+        lock_guard<mutex> lg(lock);
+        bool wasEmpty = bottom == top;
+        while (bottom - top + n > buffer.size()) grow();
+        try {
+            for (size_t i = 0; i < n; i++) {
+                buffer[bottom & (buffer.size() - 1)] = gen();
+                bottom++;
+            }
+        } catch (...) {
+            count.store(bottom - top, memory_order_seq_cst);
+            throw;
+        }
+        count.store(bottom - top, memory_order_seq_cst);
+        return wasEmpty;
+    }
+
+  /**
+  * Pops the most recently pushed element from the bottom of the deque.
+  * Returns false if the deque is empty.  Safe to call from any thread,
+  * though in the pool only a worker pops, and only from its own deque.
+  */
+    bool pop(T& elem) {
+        if (empty()) return false;
+        lock_guard<mutex> lg(lock);
+        if (bottom == top) return false;
+        bottom--;
+        take(bottom, elem);
+        count.store(bottom - top, memory_order_seq_cst);
+        return true;
+    }
+
+  /**
+  * Removes the oldest element from the top of the deque.  Returns false
+  * if the deque is empty.  Safe to call from any thread.
+  */
+    bool steal(T& elem) {
+        if (empty()) return false;
+        lock_guard<mutex> lg(lock);
+        if (bottom == top) return false;
+        take(top, elem);
+        top++;
+        count.store(bottom - top, memory_order_seq_cst);
+        return true;
+    }
+
+  /**
+  * Returns the number of queued elements.  The value may be stale by the
+  * time the caller looks at it, so it is only meant as a hint.
+  */
+    size_t size() const { return count.load(memory_order_seq_cst); }
+    bool empty() const { return size() == 0; }
+
+  private:
+
+    void take(size_t index, T& elem) {
+        T& slot = buffer[index & (buffer.size() - 1)];
+        elem = move(slot);
+        slot = T();                         // release whatever the element captured
+    }
+
+    void grow() {
+        vector<T> bigger(buffer.size() * 2);
+        for (size_t i = top; i != bottom; i++) {
+            bigger[i & (bigger.size() - 1)] = move(buffer[i & (buffer.size() - 1)]);
+        }
+        buffer.swap(bigger);
+    }
+
+    vector<T> buffer;                       // circular storage, size is a power of two
+    size_t top;                             // index of the oldest element
+    size_t bottom;                          // index one past the newest element
+    atomic<size_t> count;                   // bottom - top, readable without the lock
+    mutex lock;                             // protects buffer, top and bottom
+
+    WorkDeque(const WorkDeque& original) = delete;
+    WorkDeque& operator=(const WorkDeque& rhs) = delete;
+};
+
+#endif